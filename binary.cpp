@@ -0,0 +1,241 @@
+#include "parser.h"
+#include <string>
+#include <vector>
+#include <cstring>
+
+const char BinaryCursor::magic[4] = {'\0', 'D', 'M', 'B'};
+
+// a leading NUL never starts a text document, so the two cannot be confused
+bool BinaryCursor::is_binary(const char* begin, const char* end) {
+	return end - begin >= 5 && std::memcmp(begin, magic, 4) == 0;
+}
+
+void BinaryCursor::header() {
+	if (!is_binary(_cur, _end)) {
+		throw InputException(std::string("not a binary document"));
+	}
+	_cur += 4;
+	if (byte() != version) {
+		throw InputException(std::string("unsupported binary version"));
+	}
+}
+
+unsigned char BinaryCursor::byte() {
+	if (_cur == _end) {
+		throw InputException(std::string("truncated binary document"));
+	}
+	return (unsigned char)*_cur++;
+}
+
+unsigned long long BinaryCursor::varint() {
+	unsigned long long v = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		unsigned char b = byte();
+		v |= (unsigned long long)(b & 0x7f) << shift;
+		if (!(b & 0x80)) {
+			return v;
+		}
+	}
+	throw InputException(std::string("malformed varint"));
+}
+
+std::size_t BinaryCursor::count() {
+	unsigned long long n = varint();
+	if (n > (unsigned long long)(_end - _cur)) {
+		throw InputException(std::string("truncated binary document"));
+	}
+	return (std::size_t)n;
+}
+
+long long BinaryCursor::zigzag() {
+	unsigned long long v = varint();
+	return (long long)(v >> 1) ^ -(long long)(v & 1);
+}
+
+double BinaryCursor::float64() {
+	std::string_view b = bytes(8);
+	unsigned long long bits = 0;
+	for (int i = 7; i >= 0; --i) {
+		bits = (bits << 8) | (unsigned char)b[i];
+	}
+	double x;
+	std::memcpy(&x, &bits, sizeof(x));
+	return x;
+}
+
+std::string_view BinaryCursor::bytes(std::size_t n) {
+	if (n > (std::size_t)(_end - _cur)) {
+		throw InputException(std::string("truncated binary document"));
+	}
+	std::string_view s(_cur, n);
+	_cur += n;
+	return s;
+}
+
+std::string_view BinaryCursor::name() {
+	unsigned long long i = varint();
+	if (i >= names.size()) {
+		throw InputException(std::string("name index out of range"));
+	}
+	return names[(std::size_t)i];
+}
+
+Encoder::Encoder(std::string& out): _out(out) {}
+
+void Encoder::write(Node& n) {
+	collect(n);
+	_out.append(BinaryCursor::magic, 4);
+	_out += (char)BinaryCursor::version;
+	varint(_names.size());
+	for (std::size_t i = 0; i < _names.size(); ++i) {
+		bytes(_names[i]);
+	}
+	write_node(n);
+	_name_ids.clear();
+	_names.clear();
+	_class_names.clear();
+}
+
+void Encoder::write(Document& doc) {
+	for (Document::anchor_table::iterator it = doc.anchors().begin(); it != doc.anchors().end(); ++it) {
+		_anchor_names[(*it).second] = (*it).first;
+	}
+	write(doc.root());
+	_anchor_names.clear();
+}
+
+void Encoder::collect(Node& n) {
+	if (!_anchor_names.empty()) {
+		std::unordered_map<const Node*,std::string_view>::iterator a = _anchor_names.find(&n);
+		if (a != _anchor_names.end()) {
+			add_name((*a).second);
+		}
+	}
+	switch (n.get_type()) {
+		case Node::ObjMap:
+		case Node::ObjSequence:
+			add_name(*_class_names.insert(n.get_class_name()).first);
+			// fall through
+		case Node::Map:
+		case Node::Sequence:
+			for (Node::iterator it = n.begin(); it != n.end(); ++it) {
+				if (n.get_type() == Node::Map || n.get_type() == Node::ObjMap) {
+					add_name(it.key());
+				}
+				collect(**it);
+			}
+			break;
+		case Node::Reference:
+		case Node::Link:
+			add_name(n.get_target());
+			break;
+		default:
+			break;
+	}
+}
+
+// the table keeps views; keys, anchors and targets live in the tree, class
+// names are only handed out as copies and are kept in _class_names
+void Encoder::add_name(std::string_view name) {
+	if (_name_ids.find(name) == _name_ids.end()) {
+		_name_ids[name] = (unsigned int)_names.size();
+		_names.push_back(name);
+	}
+}
+
+void Encoder::name(std::string_view name) {
+	varint((*_name_ids.find(name)).second);
+}
+
+void Encoder::write_node(Node& n) {
+	if (!_anchor_names.empty()) {
+		std::unordered_map<const Node*,std::string_view>::iterator a = _anchor_names.find(&n);
+		if (a != _anchor_names.end()) {
+			_out += (char)BIN_ANCHOR;
+			name((*a).second);
+		}
+	}
+	switch (n.get_type()) {
+		case Node::Map:
+		case Node::ObjMap:
+			if (n.get_type() == Node::Map) {
+				_out += (char)BIN_MAP;
+			} else {
+				_out += (char)BIN_OBJMAP;
+				name(n.get_class_name());
+			}
+			varint(n.size());
+			for (Node::iterator it = n.begin(); it != n.end(); ++it) {
+				name(it.key());
+				write_node(**it);
+			}
+			break;
+		case Node::Sequence:
+		case Node::ObjSequence:
+			if (n.get_type() == Node::Sequence) {
+				_out += (char)BIN_SEQUENCE;
+			} else {
+				_out += (char)BIN_OBJSEQUENCE;
+				name(n.get_class_name());
+			}
+			varint(n.size());
+			for (Node::iterator it = n.begin(); it != n.end(); ++it) {
+				write_node(**it);
+			}
+			break;
+		case Node::Reference:
+		case Node::Link:
+			_out += (char)(n.get_type() == Node::Reference ? BIN_REFERENCE : BIN_LINK);
+			name(n.get_target());
+			break;
+		case Node::Int: {
+			long long v;
+			n >> v;
+			_out += (char)BIN_INT;
+			varint(((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63));
+			break;
+		}
+		case Node::Float: {
+			double x;
+			n >> x;
+			unsigned long long bits;
+			std::memcpy(&bits, &x, sizeof(bits));
+			char b[8];
+			for (int i = 0; i < 8; ++i) {
+				b[i] = (char)(bits >> (8 * i));
+			}
+			_out += (char)BIN_FLOAT;
+			_out.append(b, 8);
+			break;
+		}
+		case Node::Boolean: {
+			bool v;
+			n >> v;
+			_out += (char)(v ? BIN_TRUE : BIN_FALSE);
+			break;
+		}
+		case Node::String:
+		default:
+			n >> _text;
+			_out += (char)BIN_STRING;
+			bytes(_text);
+			break;
+	}
+}
+
+void Encoder::varint(unsigned long long v) {
+	char b[10];
+	int n = 0;
+	do {
+		b[n] = (char)(v & 0x7f);
+		v >>= 7;
+		if (v) b[n] |= (char)0x80;
+		++n;
+	} while (v);
+	_out.append(b, n);
+}
+
+void Encoder::bytes(std::string_view s) {
+	varint(s.size());
+	_out.append(s.data(), s.size());
+}
@@ -0,0 +1,97 @@
+#include "parser.h"
+#include <string>
+#include <climits>
+#include <charconv>
+
+// aliases only name values, so they are passed over wherever they appear
+void Binder::next() {
+	do {
+		if (!_reader.next(_event)) {
+			throw BindException(_event.line, std::string("unexpected end of document"));
+		}
+	} while (_event.kind == Reader::Event::Alias);
+}
+
+// drops the value whose first event was just read
+void Binder::skip() {
+	if (_event.kind == Reader::Event::BeginMap || _event.kind == Reader::Event::BeginSeq ||
+		_event.kind == Reader::Event::BeginObject) {
+		_reader.skip();
+	}
+}
+
+void Binder::expect(Reader::Event::Kind kind, const char* what) {
+	if (_event.kind != kind) {
+		std::string found = _event.kind == Reader::Event::Reference || _event.kind == Reader::Event::Link ?
+			std::string("a reference, which cannot be bound") : types[_event.type];
+		throw BindException(_event.line, std::string("expected ") + what + ", found " + found);
+	}
+}
+
+// the same conversions as Parser::to_int and Parser::to_float, on the text
+// of the event
+void Binder::read_value(long long& n) {
+	expect(Reader::Event::Scalar, "Int");
+	if (_event.type != Node::Int) {
+		throw BindException(_event.line, std::string("expected Int, found ") + types[_event.type]);
+	}
+	const char *first = _event.text.data(), *last = first + _event.text.size();
+	if (first != last && *first == '+') {
+		++first;
+	}
+	std::from_chars_result r = std::from_chars(first, last, n, 10);
+	if (r.ec == std::errc::result_out_of_range) {
+		throw BindException(_event.line, std::string("integer out of range: ") + _event.text);
+	}
+	if (r.ec != std::errc() || r.ptr != last) {
+		throw BindException(_event.line, std::string("malformed Int: ") + _event.text);
+	}
+}
+
+void Binder::read_value(int& n) {
+	long long value;
+	read_value(value);
+	if (value < INT_MIN || value > INT_MAX) {
+		throw BindException(_event.line, std::string("value out of range: ") + _event.text);
+	}
+	n = (int)value;
+}
+
+void Binder::read_value(double& x) {
+	expect(Reader::Event::Scalar, "Float");
+	if (_event.type != Node::Float) {
+		throw BindException(_event.line, std::string("expected Float, found ") + types[_event.type]);
+	}
+	const char *first = _event.text.data(), *last = first + _event.text.size();
+	bool negative = false;
+	if (first != last && (*first == '+' || *first == '-')) {
+		negative = *first == '-';
+		++first;
+	}
+	std::from_chars_result r = std::from_chars(first, last, x, std::chars_format::general);
+	if (r.ec == std::errc::result_out_of_range) {
+		throw BindException(_event.line, std::string("number out of range: ") + _event.text);
+	}
+	if (r.ec != std::errc() || r.ptr != last) {
+		throw BindException(_event.line, std::string("malformed Float: ") + _event.text);
+	}
+	if (negative) {
+		x = -x;
+	}
+}
+
+void Binder::read_value(bool& b) {
+	expect(Reader::Event::Scalar, "Boolean");
+	if (_event.type != Node::Boolean) {
+		throw BindException(_event.line, std::string("expected Boolean, found ") + types[_event.type]);
+	}
+	b = _event.text == "true";
+}
+
+void Binder::read_value(std::string& s) {
+	expect(Reader::Event::Scalar, "String");
+	if (_event.type != Node::String) {
+		throw BindException(_event.line, std::string("expected String, found ") + types[_event.type]);
+	}
+	s.swap(_event.text);
+}
@@ -0,0 +1,298 @@
+#include "parser.h"
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cmath>
+#include <cerrno>
+#include <charconv>
+
+#if defined(_WIN32)
+#include <io.h>
+#define dmon_write _write
+#else
+#include <unistd.h>
+#define dmon_write ::write
+#endif
+
+Emitter::Emitter(int fd, Style style):
+	_fd(fd), _out(0), _style(style), _attached(false), _pos(_buffer) {}
+
+Emitter::Emitter(std::string& out, Style style):
+	_fd(-1), _out(&out), _style(style), _attached(false), _pos(_buffer) {}
+
+Emitter::~Emitter() {
+	try {
+		flush();
+	} catch (...) {
+	}
+}
+
+void Emitter::begin_map() {
+	open('{', '}');
+}
+
+void Emitter::begin_seq() {
+	open('[', ']');
+}
+
+void Emitter::begin_object(std::string_view class_name) {
+	item();
+	put('!');
+	identifier(class_name);
+	put('(');
+	Frame f = {')', 0};
+	_stack.push_back(f);
+}
+
+void Emitter::end() {
+	if (_stack.empty()) {
+		throw EmitException(std::string("end outside of a container"));
+	}
+	if (_attached) {
+		throw EmitException(std::string("key or anchor without a value"));
+	}
+	Frame f = _stack.back();
+	_stack.pop_back();
+	if (_style == Emitter::Pretty && f.count > 0) {
+		put('\n');
+		for (std::size_t i = 0; i < _stack.size(); ++i) {
+			put('\t');
+		}
+	}
+	put(f.closing);
+}
+
+void Emitter::key(std::string_view name) {
+	item();
+	identifier(name);
+	put(':');
+	if (_style == Emitter::Pretty) {
+		put(' ');
+	}
+	_attached = true;
+}
+
+void Emitter::anchor(std::string_view name) {
+	item();
+	put('&');
+	identifier(name);
+	put(' ');
+	_attached = true;
+}
+
+// only the characters the lexer treats specially are escaped; anything
+// else, newlines included, is taken literally inside quotes
+void Emitter::value(std::string_view s) {
+	item();
+	put('"');
+	const char *run = s.data(), *end = s.data() + s.size();
+	for (const char *c = run; c != end; ++c) {
+		if (*c == '"' || *c == '\\' || *c == '#') {
+			put(run, c - run);
+			put('\\');
+			run = c;
+		}
+	}
+	put(run, end - run);
+	put('"');
+}
+
+void Emitter::value(long long n) {
+	item();
+	char buf[24];
+	std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), n);
+	put(buf, r.ptr - buf);
+}
+
+// shortest text that reads back to the same double; it must keep a point
+// or an exponent, or it would be read back as an integer
+void Emitter::value(double x) {
+	if (!std::isfinite(x)) {
+		throw EmitException(std::string("number has no dmon form"));
+	}
+	item();
+	char buf[32];
+	std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), x);
+	put(buf, r.ptr - buf);
+	if (!std::memchr(buf, '.', r.ptr - buf) && !std::memchr(buf, 'e', r.ptr - buf)) {
+		put(".0", 2);
+	}
+}
+
+void Emitter::value(bool b) {
+	item();
+	if (b) {
+		put("true", 4);
+	} else {
+		put("false", 5);
+	}
+}
+
+void Emitter::reference(std::string_view alias) {
+	item();
+	put('*');
+	identifier(alias);
+}
+
+void Emitter::link(std::string_view alias) {
+	item();
+	put('@');
+	identifier(alias);
+}
+
+void Emitter::write(Node& n) {
+	write_node(n);
+	if (_style == Emitter::Pretty) {
+		put('\n');
+	}
+}
+
+void Emitter::write(Document& doc) {
+	for (Document::anchor_table::iterator it = doc.anchors().begin(); it != doc.anchors().end(); ++it) {
+		_anchor_names[(*it).second] = (*it).first;
+	}
+	write(doc.root());
+	_anchor_names.clear();
+}
+
+void Emitter::flush() {
+	std::size_t n = _pos - _buffer;
+	_pos = _buffer;
+	if (_out) {
+		_out->append(_buffer, n);
+		return;
+	}
+	const char *p = _buffer;
+	while (n > 0) {
+		long w = (long)dmon_write(_fd, p, (unsigned int)n);
+		if (w < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw EmitException(std::string("write failed"));
+		}
+		p += w;
+		n -= (std::size_t)w;
+	}
+}
+
+void Emitter::put_chunked(const char* s, std::size_t n) {
+	while (n > 0) {
+		std::size_t room = _buffer + buffer_size - _pos;
+		if (room == 0) {
+			flush();
+			room = buffer_size;
+		}
+		std::size_t k = n < room ? n : room;
+		std::memcpy(_pos, s, k);
+		_pos += k;
+		s += k;
+		n -= k;
+	}
+}
+
+// separates the next key or value from the previous one, unless a key
+// or anchor already stands in front of it
+void Emitter::item() {
+	if (_attached) {
+		_attached = false;
+		return;
+	}
+	if (_stack.empty()) {
+		return;
+	}
+	if (_stack.back().count++ > 0) {
+		put(',');
+	}
+	if (_style == Emitter::Pretty) {
+		put('\n');
+		for (std::size_t i = 0; i < _stack.size(); ++i) {
+			put('\t');
+		}
+	}
+}
+
+void Emitter::open(char opening, char closing) {
+	item();
+	put(opening);
+	Frame f = {closing, 0};
+	_stack.push_back(f);
+}
+
+// names must lex back as identifiers, so true and false are out as well
+void Emitter::identifier(std::string_view name) {
+	bool valid = !name.empty() && !(name[0] >= '0' && name[0] <= '9') && name != "true" && name != "false";
+	for (std::size_t i = 0; valid && i < name.size(); ++i) {
+		char c = name[i];
+		valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+	}
+	if (!valid) {
+		throw EmitException(std::string("invalid identifier " + std::string(name)));
+	}
+	put(name.data(), name.size());
+}
+
+void Emitter::write_node(Node& n) {
+	if (!_anchor_names.empty()) {
+		std::unordered_map<const Node*,std::string_view>::iterator a = _anchor_names.find(&n);
+		if (a != _anchor_names.end()) {
+			anchor((*a).second);
+		}
+	}
+	switch (n.get_type()) {
+		case Node::Map:
+		case Node::ObjMap:
+			if (n.get_type() == Node::Map) {
+				begin_map();
+			} else {
+				begin_object(n.get_class_name());
+			}
+			for (Node::iterator it = n.begin(); it != n.end(); ++it) {
+				key(it.key());
+				write_node(**it);
+			}
+			end();
+			break;
+		case Node::Sequence:
+		case Node::ObjSequence:
+			if (n.get_type() == Node::Sequence) {
+				begin_seq();
+			} else {
+				begin_object(n.get_class_name());
+			}
+			for (Node::iterator it = n.begin(); it != n.end(); ++it) {
+				write_node(**it);
+			}
+			end();
+			break;
+		case Node::Reference:
+			reference(n.get_target());
+			break;
+		case Node::Link:
+			link(n.get_target());
+			break;
+		case Node::Int: {
+			long long v;
+			n >> v;
+			value(v);
+			break;
+		}
+		case Node::Float: {
+			double v;
+			n >> v;
+			value(v);
+			break;
+		}
+		case Node::Boolean: {
+			bool v;
+			n >> v;
+			value(v);
+			break;
+		}
+		case Node::String:
+		default:
+			n >> _text;
+			value(std::string_view(_text));
+			break;
+	}
+}
@@ -0,0 +1,479 @@
+#include "parser.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <climits>
+
+const char Image::magic[4] = {'\0', 'D', 'M', 'I'};
+
+static bool anchor_less(const std::pair<std::string_view,const Node*>& a, const std::pair<std::string_view,const Node*>& b) {
+	return a.first < b.first;
+}
+
+Image::Image(const std::string& filename, InputBuffer::Mode mode):
+	_input(filename, mode), _base(0), _size(0)
+{
+	_input.set_random_access();
+	open();
+}
+
+Image::Image(const char* begin, const char* end):
+	_input(begin, end), _base(0), _size(0)
+{
+	open();
+}
+
+bool Image::is_image(const char* begin, const char* end) {
+	return end - begin >= (std::ptrdiff_t)sizeof(ImageHeader) && std::memcmp(begin, magic, 4) == 0;
+}
+
+std::size_t Image::index_size(std::size_t count) {
+	if (count <= small_map_size) {
+		return 0;
+	}
+	std::size_t slots = 16;
+	while (slots < 2 * count) {
+		slots <<= 1;
+	}
+	return slots;
+}
+
+std::uint32_t Image::hash(std::string_view key) {
+	std::uint32_t h = 2166136261u;
+	for (std::size_t i = 0; i < key.size(); ++i) {
+		h = (h ^ (unsigned char)key[i]) * 16777619u;
+	}
+	return h;
+}
+
+// only the header, the root and the anchor table are looked at here; the
+// rest is checked as it is reached, so opening costs the same at any size
+void Image::open() {
+	if (!is_image(_input.begin(), _input.end())) {
+		throw InputException(std::string("not a document image"));
+	}
+	// records hold 8-byte numbers at offsets that are multiples of 8
+	if ((std::size_t)_input.begin() % std::max(alignof(ImageHeader), alignof(ImageRecord)) != 0) {
+		throw InputException(std::string("misaligned document image"));
+	}
+	const ImageHeader *h = reinterpret_cast<const ImageHeader*>(_input.begin());
+	if (h->version != version) {
+		throw InputException(std::string("unsupported image version"));
+	}
+	if (h->byte_order != byte_order) {
+		throw InputException(std::string("image written with another byte order"));
+	}
+	if (h->size < sizeof(ImageHeader) || h->size > _input.size()) {
+		throw InputException(std::string("truncated document image"));
+	}
+	_base = _input.begin();
+	_size = h->size;
+	record(h->root);
+	words(h->anchors, 2 * (std::size_t)h->anchor_count);
+}
+
+ImageNode Image::root() {
+	return ImageNode(this, record(reinterpret_cast<const ImageHeader*>(_base)->root));
+}
+
+ImageNode Image::get_anchor(std::string_view alias) {
+	const ImageHeader *h = reinterpret_cast<const ImageHeader*>(_base);
+	const std::uint32_t *a = words(h->anchors, 2 * (std::size_t)h->anchor_count);
+	std::size_t lo = 0, hi = h->anchor_count;
+	while (lo < hi) {
+		std::size_t mid = lo + (hi - lo) / 2;
+		std::string_view name = string(a[2 * mid]);
+		if (name == alias) {
+			return ImageNode(this, record(a[2 * mid + 1]));
+		} else if (name < alias) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	throw NodeException(std::string("unknown alias"));
+}
+
+const ImageRecord* Image::record(std::uint32_t offset) const {
+	if (offset < sizeof(ImageHeader) || offset % alignof(ImageRecord) != 0 || offset > _size - sizeof(ImageRecord)) {
+		throw InputException(std::string("image offset out of bounds"));
+	}
+	const ImageRecord *r = reinterpret_cast<const ImageRecord*>(_base + offset);
+	if (r->type > Node::Link) {
+		throw InputException(std::string("unknown record type in image"));
+	}
+	return r;
+}
+
+const std::uint32_t* Image::words(std::uint32_t offset, std::size_t n) const {
+	if (offset % sizeof(std::uint32_t) != 0 || offset > _size || n > (_size - offset) / sizeof(std::uint32_t)) {
+		throw InputException(std::string("image offset out of bounds"));
+	}
+	return reinterpret_cast<const std::uint32_t*>(_base + offset);
+}
+
+std::string_view Image::string(std::uint32_t offset) const {
+	std::uint32_t length = *words(offset, 1);
+	if (length > _size - offset - sizeof(std::uint32_t)) {
+		throw InputException(std::string("image offset out of bounds"));
+	}
+	return std::string_view(_base + offset + sizeof(std::uint32_t), length);
+}
+
+// references were collapsed when the image was written, so one step is enough
+const ImageRecord* ImageNode::target() const {
+	if (_record->type != Node::Reference && _record->type != Node::Link) {
+		return _record;
+	}
+	const ImageRecord *r = _image->record(_record->value.items.data);
+	if (r->type == Node::Reference || r->type == Node::Link) {
+		throw InputException(std::string("reference to a reference in image"));
+	}
+	return r;
+}
+
+bool ImageNode::is_map(const ImageRecord* r) const {
+	return r->type == Node::Map || r->type == Node::ObjMap;
+}
+
+const std::uint32_t* ImageNode::items(const ImageRecord* r) const {
+	std::size_t n = r->value.items.count;
+	if (is_map(r)) {
+		n = 2 * n + Image::index_size(n);
+	} else if (r->type != Node::Sequence && r->type != Node::ObjSequence) {
+		throw NodeException(std::string("type mismatch"));
+	}
+	return _image->words(r->value.items.data, n);
+}
+
+ImageNode ImageNode::operator [](size_type n) const {
+	const ImageRecord *r = target();
+	if (r->type != Node::Sequence && r->type != Node::ObjSequence) {
+		throw NodeException(std::string("type mismatch"));
+	}
+	if (n >= r->value.items.count) {
+		throw NodeException(std::string("invalid access"));
+	}
+	return ImageNode(_image, _image->record(items(r)[n]));
+}
+
+ImageNode ImageNode::operator [](std::string_view key) const {
+	ImageNode n = find(key);
+	if (n) {
+		return n;
+	} else {
+		throw NodeException(std::string("invalid access"));
+	}
+}
+
+// keys are compared by contents here; an image has no pool to intern against
+ImageNode ImageNode::find(std::string_view key) const {
+	const ImageRecord *r = target();
+	if (!is_map(r)) {
+		throw NodeException(std::string("type mismatch"));
+	}
+	std::size_t count = r->value.items.count;
+	const std::uint32_t *entries = items(r);
+	std::size_t slots = Image::index_size(count);
+	if (slots == 0) {
+		for (std::size_t i = 0; i < count; ++i) {
+			if (_image->string(entries[2 * i]) == key) {
+				return ImageNode(_image, _image->record(entries[2 * i + 1]));
+			}
+		}
+		return ImageNode();
+	}
+	const std::uint32_t *index = entries + 2 * count;
+	std::size_t mask = slots - 1;
+	std::size_t i = Image::hash(key) & mask;
+	for (std::size_t probes = 0; probes < slots && index[i] != 0; ++probes, i = (i + 1) & mask) {
+		std::size_t e = index[i] - 1;
+		if (e >= count) {
+			throw InputException(std::string("map index out of range in image"));
+		}
+		if (_image->string(entries[2 * e]) == key) {
+			return ImageNode(_image, _image->record(entries[2 * e + 1]));
+		}
+	}
+	return ImageNode();
+}
+
+ImageNode::size_type ImageNode::size() const {
+	const ImageRecord *r = target();
+	switch (r->type) {
+		case Node::Map:
+		case Node::ObjMap:
+		case Node::Sequence:
+		case Node::ObjSequence:
+			return r->value.items.count;
+		default:
+			throw NodeException(std::string("type mismatch"));
+	}
+}
+
+std::string ImageNode::get_class_name() const {
+	const ImageRecord *r = target();
+	if (r->type != Node::ObjMap && r->type != Node::ObjSequence) {
+		throw NodeException(std::string("type mismatch"));
+	}
+	std::string_view name = _image->string(r->name);
+	return std::string(name.data(), name.size());
+}
+
+void ImageNode::operator >>(int &n) const {
+	long long v;
+	*this >> v;
+	if (v < INT_MIN || v > INT_MAX) {
+		throw NodeException(std::string("value out of range"));
+	}
+	n = (int)v;
+}
+
+void ImageNode::operator >>(long long &n) const {
+	const ImageRecord *r = target();
+	if (r->type != Node::Int) {
+		throw NodeException(std::string("type mismatch"));
+	}
+	n = r->value.integer;
+}
+
+void ImageNode::operator >>(double &x) const {
+	const ImageRecord *r = target();
+	if (r->type != Node::Float) {
+		throw NodeException(std::string("type mismatch"));
+	}
+	x = r->value.real;
+}
+
+void ImageNode::operator >>(std::string &s) const {
+	std::string_view v = view();
+	s.assign(v.data(), v.size());
+}
+
+void ImageNode::operator >>(bool &b) const {
+	const ImageRecord *r = target();
+	if (r->type != Node::Boolean) {
+		throw NodeException(std::string("type mismatch"));
+	}
+	b = r->value.integer != 0;
+}
+
+std::string_view ImageNode::view() const {
+	const ImageRecord *r = target();
+	if (r->type != Node::String) {
+		throw NodeException(std::string("type mismatch"));
+	}
+	return _image->string(r->name);
+}
+
+ImageNode::iterator ImageNode::begin() const {
+	const ImageRecord *r = target();
+	return iterator(_image, items(r), is_map(r) ? 2 : 1);
+}
+
+ImageNode::iterator ImageNode::end() const {
+	const ImageRecord *r = target();
+	return begin() + r->value.items.count;
+}
+
+ImageNode ImageNode::resolve() const {
+	return ImageNode(_image, target());
+}
+
+std::string_view ImageNode::get_target() const {
+	if (_record->type != Node::Reference && _record->type != Node::Link) {
+		throw NodeException(std::string("invalid access"));
+	}
+	return _image->string(_record->name);
+}
+
+ImageWriter::ImageWriter(std::string& out): _out(out), _start(0) {}
+
+void ImageWriter::write(Node& n) {
+	collect(n);
+	_start = _out.size();
+	reserve(sizeof(ImageHeader), alignof(ImageHeader));
+	ImageHeader h;
+	std::memset(&h, 0, sizeof(h));
+	std::memcpy(h.magic, Image::magic, 4);
+	h.version = Image::version;
+	h.byte_order = Image::byte_order;
+	h.root = write_node(n);
+	for (std::size_t i = 0; i < _references.size(); ++i) {
+		std::unordered_map<const Node*,std::uint32_t>::iterator t = _targets.find(_references[i].second);
+		if (t == _targets.end() || (*t).second == 0) {
+			throw EmitException(std::string("reference to a node outside the image"));
+		}
+		ImageRecord r;
+		std::memcpy(&r, &_out[_start + _references[i].first], sizeof(r));
+		r.value.items.data = (*t).second;
+		put(_references[i].first, &r, sizeof(r));
+	}
+	std::sort(_anchors.begin(), _anchors.end(), anchor_less);
+	std::vector<std::uint32_t> anchors;
+	for (std::size_t i = 0; i < _anchors.size(); ++i) {
+		anchors.push_back(name(_anchors[i].first));
+		anchors.push_back(_targets[_anchors[i].second]);
+	}
+	h.anchor_count = (std::uint32_t)_anchors.size();
+	h.anchors = reserve(anchors.size() * sizeof(std::uint32_t), sizeof(std::uint32_t));
+	if (!anchors.empty()) {
+		put(h.anchors, &anchors[0], anchors.size() * sizeof(std::uint32_t));
+	}
+	h.size = (std::uint32_t)(_out.size() - _start);
+	put(0, &h, sizeof(h));
+	_names.clear();
+	_class_names.clear();
+	_targets.clear();
+	_references.clear();
+}
+
+void ImageWriter::write(Document& doc) {
+	for (Document::anchor_table::iterator it = doc.anchors().begin(); it != doc.anchors().end(); ++it) {
+		_anchors.push_back(std::pair<std::string_view,const Node*>((*it).first, (*it).second));
+		_targets[(*it).second] = 0;
+	}
+	write(doc.root());
+	_anchors.clear();
+}
+
+// notes the nodes references resolve to, so their offsets are kept as they are written
+void ImageWriter::collect(Node& n) {
+	switch (n.get_type()) {
+		case Node::Map:
+		case Node::ObjMap:
+		case Node::Sequence:
+		case Node::ObjSequence:
+			for (Node::iterator it = n.begin(); it != n.end(); ++it) {
+				collect(**it);
+			}
+			break;
+		case Node::Reference:
+		case Node::Link:
+			if (n.resolve()) {
+				_targets[n.resolve()] = 0;
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+std::uint32_t ImageWriter::reserve(std::size_t n, std::size_t align) {
+	std::size_t at = _out.size() - _start;
+	at += (align - at % align) % align;
+	if (at + n > UINT_MAX) {
+		throw EmitException(std::string("document too large for an image"));
+	}
+	_out.resize(_start + at + n, '\0');
+	return (std::uint32_t)at;
+}
+
+// names are written once and shared by every record that uses them
+std::uint32_t ImageWriter::name(std::string_view s) {
+	std::unordered_map<std::string_view,std::uint32_t>::iterator it = _names.find(s);
+	if (it != _names.end()) {
+		return (*it).second;
+	}
+	std::uint32_t at = string(s);
+	_names[s] = at;
+	return at;
+}
+
+std::uint32_t ImageWriter::string(std::string_view s) {
+	std::uint32_t at = reserve(sizeof(std::uint32_t) + s.size(), sizeof(std::uint32_t));
+	std::uint32_t length = (std::uint32_t)s.size();
+	put(at, &length, sizeof(length));
+	put(at + sizeof(length), s.data(), s.size());
+	return at;
+}
+
+// a container's record and data come before its children, which fill the
+// data in as they are written
+std::uint32_t ImageWriter::write_node(Node& n) {
+	ImageRecord r;
+	std::memset(&r, 0, sizeof(r));
+	r.type = n.get_type();
+	std::uint32_t at = reserve(sizeof(r), alignof(ImageRecord));
+	switch (n.get_type()) {
+		case Node::Map:
+		case Node::ObjMap: {
+			if (n.get_type() == Node::ObjMap) {
+				r.name = name(*_class_names.insert(n.get_class_name()).first);
+			}
+			std::size_t count = n.size();
+			std::size_t slots = Image::index_size(count);
+			r.value.items.count = (std::uint32_t)count;
+			r.value.items.data = count ? reserve((2 * count + slots) * sizeof(std::uint32_t), sizeof(std::uint32_t)) : 0;
+			std::vector<std::uint32_t> index(slots, 0);
+			std::uint32_t i = 0;
+			for (Node::iterator it = n.begin(); it != n.end(); ++it, ++i) {
+				std::uint32_t entry[2];
+				entry[0] = name(it.key());
+				entry[1] = write_node(**it);
+				put(r.value.items.data + 2 * i * sizeof(std::uint32_t), entry, sizeof(entry));
+				if (slots) {
+					std::size_t s = Image::hash(it.key()) & (slots - 1);
+					while (index[s] != 0) {
+						s = (s + 1) & (slots - 1);
+					}
+					index[s] = i + 1;
+				}
+			}
+			if (slots) {
+				put(r.value.items.data + 2 * count * sizeof(std::uint32_t), &index[0], slots * sizeof(std::uint32_t));
+			}
+			break;
+		}
+		case Node::Sequence:
+		case Node::ObjSequence: {
+			if (n.get_type() == Node::ObjSequence) {
+				r.name = name(*_class_names.insert(n.get_class_name()).first);
+			}
+			std::size_t count = n.size();
+			r.value.items.count = (std::uint32_t)count;
+			r.value.items.data = count ? reserve(count * sizeof(std::uint32_t), sizeof(std::uint32_t)) : 0;
+			std::uint32_t i = 0;
+			for (Node::iterator it = n.begin(); it != n.end(); ++it, ++i) {
+				std::uint32_t element = write_node(**it);
+				put(r.value.items.data + i * sizeof(std::uint32_t), &element, sizeof(element));
+			}
+			break;
+		}
+		case Node::Reference:
+		case Node::Link:
+			r.name = name(n.get_target());
+			_references.push_back(std::pair<std::uint32_t,const Node*>(at, n.resolve()));
+			break;
+		case Node::Int:
+			n >> r.value.integer;
+			break;
+		case Node::Float:
+			n >> r.value.real;
+			break;
+		case Node::Boolean: {
+			bool b;
+			n >> b;
+			r.value.integer = b;
+			break;
+		}
+		case Node::String:
+		default:
+			n >> _text;
+			r.name = string(_text);
+			break;
+	}
+	if (!_targets.empty()) {
+		std::unordered_map<const Node*,std::uint32_t>::iterator t = _targets.find(&n);
+		if (t != _targets.end()) {
+			(*t).second = at;
+		}
+	}
+	put(at, &r, sizeof(r));
+	return at;
+}
+
+void ImageWriter::put(std::uint32_t at, const void* p, std::size_t n) {
+	if (n) std::memcpy(&_out[_start + at], p, n);
+}
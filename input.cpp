@@ -0,0 +1,107 @@
+#include "parser.h"
+#include <istream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define DMON_HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+InputBuffer::InputBuffer(std::istream& is):
+	_mode(InputBuffer::Buffered), _begin(0), _end(0), _mapping(0), _mapping_size(0), _seconds(0)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	// pull the stream through its buffer in large chunks instead of per char
+	static const std::streamsize chunk_size = 1 << 16;
+	std::streambuf *sb = is.rdbuf();
+	std::streamsize n;
+	do {
+		std::size_t old_size = _buffer.size();
+		_buffer.resize(old_size + chunk_size);
+		n = sb->sgetn(&_buffer[old_size], chunk_size);
+		_buffer.resize(old_size + (n > 0 ? n : 0));
+	} while (n == chunk_size);
+	set_range();
+	_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+InputBuffer::InputBuffer(const char* begin, const char* end):
+	_mode(InputBuffer::Borrowed), _begin(begin), _end(end), _mapping(0), _mapping_size(0), _seconds(0) {}
+
+InputBuffer::InputBuffer(const std::string& filename, Mode mode):
+	_mode(mode), _begin(0), _end(0), _mapping(0), _mapping_size(0), _seconds(0)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#ifdef DMON_HAVE_MMAP
+	if (_mode == InputBuffer::Mapped) {
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw InputException(std::string("cannot open " + filename));
+		}
+		struct stat st;
+		if (::fstat(fd, &st) != 0) {
+			::close(fd);
+			throw InputException(std::string("cannot stat " + filename));
+		}
+		if (st.st_size > 0) {
+			void *p = ::mmap(0, (std::size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) {
+				::madvise(p, (std::size_t)st.st_size, MADV_SEQUENTIAL);
+				_mapping = p;
+				_mapping_size = (std::size_t)st.st_size;
+				_begin = static_cast<const char*>(p);
+				_end = _begin + _mapping_size;
+			}
+		}
+		::close(fd);
+		if (_mapping) {
+			_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			return;
+		}
+		// empty files and files that refuse to map are read instead
+	}
+#endif
+	_mode = InputBuffer::Buffered;
+	std::ifstream file(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+	if (!file) {
+		throw InputException(std::string("cannot open " + filename));
+	}
+	file.seekg(0, std::ios_base::end);
+	std::streamoff length = file.tellg();
+	file.seekg(0, std::ios_base::beg);
+	if (length > 0) {
+		_buffer.resize((std::size_t)length);
+		if (!file.read(&_buffer[0], length)) {
+			throw InputException(std::string("cannot read " + filename));
+		}
+	}
+	set_range();
+	_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+InputBuffer::~InputBuffer() {
+#ifdef DMON_HAVE_MMAP
+	if (_mapping) {
+		::munmap(_mapping, _mapping_size);
+	}
+#endif
+}
+
+void InputBuffer::set_range() {
+	_begin = _buffer.empty() ? 0 : &_buffer[0];
+	_end = _begin + _buffer.size();
+}
+
+void InputBuffer::set_random_access() {
+#ifdef DMON_HAVE_MMAP
+	if (_mapping) {
+		::madvise(_mapping, _mapping_size, MADV_RANDOM);
+	}
+#endif
+}
@@ -0,0 +1,227 @@
+#include "parser.h"
+#include <string>
+#include <cstring>
+#include <utility>
+
+Token::Token(const Token& t):
+	type(t.type), contents(t.contents), text(t.text), owned(t.owned), line(t.line)
+{
+	if (owned) contents = text;
+}
+
+Token& Token::operator=(const Token& t) {
+	type = t.type;
+	text = t.text;
+	owned = t.owned;
+	contents = owned ? std::string_view(text) : t.contents;
+	line = t.line;
+	return *this;
+}
+
+Token::Token(Token&& t) noexcept:
+	type(t.type), contents(t.contents), text(std::move(t.text)), owned(t.owned), line(t.line)
+{
+	if (owned) contents = text;
+}
+
+Token& Token::operator=(Token&& t) noexcept {
+	type = t.type;
+	text = std::move(t.text);
+	owned = t.owned;
+	contents = owned ? std::string_view(text) : t.contents;
+	line = t.line;
+	return *this;
+}
+
+Lexer::Lexer(const char* begin, const char* end):
+	_cur(begin), _end(end), _cur_line(1), _skip_comments(true), _index(end)
+{
+	skip_comment();
+}
+
+static bool is_a_char_token(char c) {
+	switch (c) {
+		case '{': case '}': case '[': case ']': case '(': case ')':
+		case '!': case '*': case '@': case '&': case ':': case ',':
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool Lexer::lex_token(Token& t) {
+	while (_cur != _end) {
+
+		if (is_a_char_token(*_cur)) {
+			t.owned = false;
+			t.line = _cur_line;
+			t.type = *_cur == '{' ? TOK_CBRACE_L :
+	 				 *_cur == '}' ? TOK_CBRACE_R :
+					 *_cur == '[' ? TOK_SBRACE_L :
+					 *_cur == ']' ? TOK_SBRACE_R :
+					 *_cur == '(' ? TOK_RBRACE_L :
+					 *_cur == ')' ? TOK_RBRACE_R :
+					 *_cur == '!' ? TOK_BANG :
+					 *_cur == '*' ? TOK_ASTERISK :
+					 *_cur == '@' ? TOK_AT :
+					 *_cur == '&' ? TOK_AMPERSAND :
+					 *_cur == ':' ? TOK_COLON :
+									TOK_COMMA;
+			t.contents = std::string_view(_cur, 1);
+			next_sym();
+			return true;
+
+		} else if (*_cur == '"') {
+			next_sym();
+			t.line = _cur_line;
+			t.type = TOK_STRING;
+			// most strings are a plain run of the input and are returned as a view of it
+			const char *start = _cur;
+			_cur = _index.find_stop(_cur, _cur_line);
+			if (_cur != _end && *_cur == '"') {
+				t.owned = false;
+				t.contents = std::string_view(start, _cur - start);
+				next_sym();
+				return true;
+			}
+			// escapes and comments make the text differ from the input, so it is built up
+			t.owned = true;
+			t.text.assign(start, _cur - start);
+			skip_comment();
+			bool escape = false, closed = false;
+			while (_cur != _end && !closed) {
+				if (*_cur == '"') { // string termination
+					if (escape) { // unless escaped
+						escape = false;
+						t.text += '"';
+					} else {
+						closed = true;
+					}
+				} else if (*_cur == '\\') { // escape character
+					if (escape) {
+						escape = false;
+						t.text += '\\';
+					} else {
+						escape = true;
+					}
+				} else if (escape && *_cur == '#') { // comments can be escaped
+					t.text += '#';
+					escape = false;
+				} else { // other characters
+					if (escape) {
+						escape = false;
+						t.text += '\\';
+					}
+					t.text += *_cur;
+				}
+				set_skip_comments(!escape);
+				next_sym();
+			}
+			if (!closed) {
+				throw LexException(t.line, std::string("unterminated string"));
+			}
+			t.contents = t.text;
+			return true;
+
+		} else if (is_an_identifier_letter(*_cur)) { // identifier
+			const char *start = _cur;
+			t.owned = false;
+			t.type = TOK_IDENTIFIER;
+			t.line = _cur_line;
+			_cur = _index.skip_word(_cur);
+			t.contents = std::string_view(start, _cur - start);
+			skip_comment();
+			if (t.contents == "true" || t.contents == "false") {
+				t.type = TOK_BOOL;
+			}
+			return true;
+
+		} else if (is_a_digit(*_cur) || is_a_sign(*_cur) || *_cur == '.') {
+			const char *start = _cur;
+			t.owned = false;
+			t.type = TOK_INT;
+			t.line = _cur_line;
+			if (_cur != _end && is_a_sign(*_cur)) { // sign
+				++_cur;
+			}
+			while (_cur != _end && is_a_digit(*_cur)) { // integral part
+				++_cur;
+			}
+			if (_cur != _end && *_cur == '.') { // fractional part
+				t.type = TOK_FLOAT;
+				++_cur;
+				while (_cur != _end && is_a_digit(*_cur)) {
+					++_cur;
+				}
+			}
+			if (_cur != _end && (*_cur == 'e' || *_cur == 'E')) { // exponential part
+				t.type = TOK_FLOAT;
+				++_cur;
+				if (_cur != _end && is_a_sign(*_cur)) {
+					++_cur;
+				}
+				while (_cur != _end && is_a_digit(*_cur)) {
+					++_cur;
+				}
+			}
+			t.contents = std::string_view(start, _cur - start);
+			skip_comment();
+			return true;
+
+		} else if (is_whitespace(*_cur)) {
+			_cur = _index.skip_space(_cur, _cur_line);
+			skip_comment();
+		} else {
+			throw LexException(_cur_line, std::string("invalid token")); // unknown token!
+		}
+	}
+
+	return false;
+}
+
+void Lexer::skip_to(const char* p, unsigned int line) {
+	_cur = p;
+	_cur_line = line;
+	_skip_comments = true;
+	skip_comment();
+}
+
+void Lexer::set_skip_comments(bool mode) {
+	_skip_comments = mode;
+}
+
+void Lexer::next_sym() {
+	if (_cur != _end) {
+		if (*_cur == '\n') ++_cur_line;
+		++_cur;
+	}
+	skip_comment();
+}
+
+void Lexer::skip_comment() {
+	while (_skip_comments && _cur != _end && *_cur == '#') { // consecutive comment lines
+		const char *eol = static_cast<const char*>(std::memchr(_cur, '\n', _end - _cur));
+		if (eol) {
+			++_cur_line;
+			_cur = eol + 1;
+		} else {
+			_cur = _end;
+		}
+	}
+}
+
+bool Lexer::is_a_digit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+bool Lexer::is_a_sign(char c) {
+	return c == '+' || c == '-';
+}
+
+bool Lexer::is_an_identifier_letter(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool Lexer::is_whitespace(char c) {
+	return c == 0x09 || (c >= 0x0A && c <= 0x0D) || c == 0x20;
+}
@@ -3,288 +3,541 @@
 #include <string>
 #include <map>
 #include <vector>
-#include <sstream>
-
-std::map<std::string,Node*> Node::_alias_table;
-
-Node& Node::operator [](size_type n) {
-	throw NodeException(std::string("type mismatch"));
-}
-
-Node& Node::operator [](std::string key) {
-	throw NodeException(std::string("type mismatch"));
-}
-
-Node::size_type Node::size() {
-	throw NodeException(std::string("type mismatch"));
-}
-
-std::string Node::get_class_name() {
-	throw NodeException(std::string("type mismatch"));
-}
-
-void Node::set_class_name(std::string name) {
-	throw NodeException(std::string("type mismatch"));
-}
-
-void Node::operator >>(int &n) {
-	throw NodeException(std::string("type mismatch"));
-}
-
-void Node::operator >>(double &x) {
-	throw NodeException(std::string("type mismatch"));
-}
-
-void Node::operator >>(std::string &s) {
-	throw NodeException(std::string("type mismatch"));
-}
-
-void Node::operator >>(bool &b) {
-	throw NodeException(std::string("type mismatch"));
-}
-
-void Node::print(int indent) {
-	throw NodeException(std::string("attempting to print an invalid node"));
+#include <string_view>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <climits>
+
+std::string_view StringPool::intern(std::string_view s, bool borrow) {
+	if (_shared) {
+		std::lock_guard<std::mutex> hold(_lock);
+		return insert(s, borrow);
+	}
+	return insert(s, borrow);
 }
 
-Node::iterator Node::begin() {
-	throw NodeException(std::string("invalid access"));
+std::string_view StringPool::insert(std::string_view s, bool borrow) {
+	std::pmr::unordered_set<std::string_view>::iterator it = _strings.find(s);
+	if (it != _strings.end()) {
+		return *it;
+	}
+	if (borrow && s.data()) {
+		return *_strings.insert(s).first;
+	}
+	char *stored = static_cast<char*>(_mr->allocate(s.size() ? s.size() : 1, 1));
+	std::memcpy(stored, s.data(), s.size());
+	return *_strings.insert(std::string_view(stored, s.size())).first;
 }
 
-Node::iterator Node::end() {
-	throw NodeException(std::string("invalid access"));
+std::string_view StringPool::find(std::string_view s) {
+	std::pmr::unordered_set<std::string_view>::iterator it = _strings.find(s);
+	return it != _strings.end() ? *it : std::string_view();
 }
 
-void Node::set_contents(std::string contents) {
-	throw NodeException(std::string("invalid access"));
+void* CountingResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+	void *p = _upstream->allocate(bytes, alignment);
+	_bytes += bytes;
+	return p;
 }
 
-void Node::set_target(std::string target) {
-	throw NodeException(std::string("invalid access"));
+void CountingResource::do_deallocate(void* p, std::size_t bytes, std::size_t alignment) {
+	_upstream->deallocate(p, bytes, alignment);
+	_bytes -= bytes;
 }
 
-std::string Node::get_target() {
-	throw NodeException(std::string("invalid access"));
-}
+Document::Document(std::size_t initial_size, std::pmr::memory_resource* upstream):
+	_counter(upstream), _arena(initial_size > 4096 ? initial_size : 4096, &_counter),
+	_strings(&_arena), _anchors(&_arena), _root(0), _created(), _generation(0) {}
 
-void Node::add_to_map(std::string key, Node *n) {
-	throw NodeException(std::string("type mismatch"));
+// the pool and the anchor table live in the arena, so they are made again
+// in it once it has been released
+void Document::clear() {
+	_anchors.~anchor_table();
+	_strings.~StringPool();
+	_arena.release();
+	new (&_strings) StringPool(&_arena);
+	new (&_anchors) anchor_table(&_arena);
+	_root = 0;
 }
 
-void Node::add_to_seq(Node *n) {
-	throw NodeException(std::string("type mismatch"));
+std::string_view Document::copy(std::string_view s) {
+	if (s.empty()) {
+		return std::string_view();
+	}
+	char *stored = static_cast<char*>(_arena.allocate(s.size(), 1));
+	std::memcpy(stored, s.data(), s.size());
+	return std::string_view(stored, s.size());
 }
 
-void Node::add_as_anchor(std::string alias) {
-	_alias_table.insert( std::pair<std::string, Node*> (alias, this) );
+// the first definition of an alias wins; returns whether this one did
+bool Document::add_anchor(std::string_view alias, Node* n) {
+	if (_anchors.find(alias) != _anchors.end()) {
+		return false;
+	}
+	_anchors.emplace(_strings.intern(alias), n);
+	return true;
 }
 
-Node& Node::get_anchor(std::string alias) {
-	if (_alias_table.count(alias) != 0) {
-		return *(_alias_table[alias]);
+Node& Document::get_anchor(const std::string& alias) {
+	anchor_table::iterator it = _anchors.find(std::string_view(alias));
+	if (it != _anchors.end()) {
+		return *((*it).second);
 	} else throw NodeException(std::string("unknown alias"));
 }
 
-Node& NodeMap::operator [](std::string key) {
-	if (_map.count(key) != 0) {
-		return *(_map[key]);
-	} else {
-		throw NodeException(std::string("invalid access"));
+Node& Node::operator [](size_type n) {
+	switch (_type) {
+		case Sequence:
+		case ObjSequence: {
+			seq_type& seq = elements().seq;
+			if (seq.size() > n) {
+				return *(seq[n]);
+			} else {
+				throw NodeException(std::string("invalid access"));
+			}
+		}
+		case Reference:
+		case Link:
+			return (*_value.target->resolved)[n];
+		default:
+			throw NodeException(std::string("type mismatch"));
 	}
 }
 
-Node::size_type NodeMap::size() {
-	return (size_type)_map.size();
+Node& Node::operator [](std::string_view key) {
+	switch (_type) {
+		case Map:
+		case ObjMap: {
+			Node *n = find(key);
+			if (n) {
+				return *n;
+			} else {
+				throw NodeException(std::string("invalid access"));
+			}
+		}
+		case Reference:
+		case Link:
+			return (*_value.target->resolved)[key];
+		default:
+			throw NodeException(std::string("type mismatch"));
+	}
 }
 
-void NodeMap::add_to_map(std::string key, Node *n) {
-	_map.insert( std::pair<std::string,Node*>(key,n) );
+Node* Node::find(std::string_view key) {
+	switch (_type) {
+		case Map:
+		case ObjMap:
+			return lookup(key, false);
+		case Reference:
+		case Link:
+			return _value.target->resolved->find(key);
+		default:
+			throw NodeException(std::string("type mismatch"));
+	}
 }
 
-Node::iterator NodeMap::begin() {
-	return Node::iterator(_map.begin());
+Node* Node::find_interned(std::string_view key) {
+	switch (_type) {
+		case Map:
+		case ObjMap:
+			return lookup(key, true);
+		case Reference:
+		case Link:
+			return _value.target->resolved->find_interned(key);
+		default:
+			throw NodeException(std::string("type mismatch"));
+	}
 }
 
-Node::iterator NodeMap::end() {
-	return Node::iterator(_map.end());
+// the table is keyed by a hash of the key's bytes, so any key is hashed
+// once and probed directly, without asking the pool first
+static std::size_t key_hash(std::string_view key) {
+	return std::hash<std::string_view>()(key);
 }
 
-void NodeMap::print(int indent) {
-	for (int i = 0; i < indent; ++i) {
-		std::cout << " ";
+// stored keys are interned, so an interned key matches by address alone
+static bool same_key(std::string_view stored, std::string_view key, bool interned) {
+	if (stored.data() == key.data()) {
+		return stored.size() == key.size();
 	}
-	std::cout << types[_type] << " ";
-	std::cout << ":" << std::endl;
-	for (std::map<std::string,Node*>::iterator it = _map.begin(); it != _map.end(); ++it) {
-		(*it).second->print(indent+1);
+	return !interned && stored == key;
+}
+
+Node* Node::lookup(std::string_view key, bool interned) {
+	MapMembers& m = entries();
+	if (!m.slots) {
+		for (map_type::iterator it = m.map.begin(); it != m.map.end(); ++it) {
+			if (same_key((*it).key, key, interned)) {
+				return (*it).value;
+			}
+		}
+		return 0;
 	}
-}
-
-Node& NodeSeq::operator [](size_type n) {
-	if (_seq.size() > n) {
-		return *(_seq[n]);
-	} else {
-		throw NodeException(std::string("invalid access"));
+	std::size_t mask = m.slots - 1;
+	for (std::size_t i = key_hash(key) & mask; m.index[i] != 0; i = (i + 1) & mask) {
+		map_entry& e = m.map[m.index[i] - 1];
+		if (same_key(e.key, key, interned)) {
+			return e.value;
+		}
 	}
+	return 0;
 }
 
-Node::size_type NodeSeq::size() {
-	return _seq.size();
-}
-
-void NodeSeq::add_to_seq(Node *n) {
-	_seq.push_back(n);
+Node::size_type Node::size() {
+	switch (_type) {
+		case Map:
+		case ObjMap:
+			return (size_type)entries().map.size();
+		case Sequence:
+		case ObjSequence:
+			return (size_type)elements().seq.size();
+		case Reference:
+		case Link:
+			return _value.target->resolved->size();
+		default:
+			throw NodeException(std::string("type mismatch"));
+	}
 }
 
-Node::iterator NodeSeq::begin() {
-	return Node::iterator(_seq.begin());
+std::string Node::get_class_name() {
+	switch (_type) {
+		case ObjMap:
+		case ObjSequence: {
+			std::string_view name = object_name();
+			return std::string(name.data(), name.size());
+		}
+		case Reference:
+		case Link:
+			return _value.target->resolved->get_class_name();
+		default:
+			throw NodeException(std::string("type mismatch"));
+	}
 }
 
-Node::iterator NodeSeq::end() {
-	return Node::iterator(_seq.end());
+std::string_view Node::class_name() {
+	switch (_type) {
+		case ObjMap:
+		case ObjSequence:
+			return object_name();
+		case Reference:
+		case Link:
+			return _value.target->resolved->class_name();
+		default:
+			return std::string_view();
+	}
 }
 
-void NodeSeq::print(int indent) {
-	for (int i = 0; i < indent; ++i) {
-		std::cout << " ";
-	}
-	std::cout << types[_type] << " ";
-	std::cout << ":" << std::endl;
-	for (std::vector<Node*>::iterator it = _seq.begin(); it != _seq.end(); ++it) {
-		(*it)->print(indent+1);
+void Node::set_class_name(std::string_view name) {
+	switch (_type) {
+		case ObjMap:
+		case ObjSequence: {
+			StringPool *pool = _type == ObjMap ? _value.map->pool : static_cast<ObjSeqMembers*>(_value.seq)->pool;
+			object_name() = pool->intern(name);
+			break;
+		}
+		case Reference:
+		case Link:
+			_value.target->resolved->set_class_name(name);
+			break;
+		default:
+			throw NodeException(std::string("type mismatch"));
 	}
 }
 
-std::string NodeObjMap::get_class_name() {
-	return _name;
+void Node::operator >>(int &n) {
+	switch (_type) {
+		case Int:
+			if (_value.i < INT_MIN || _value.i > INT_MAX) {
+				throw NodeException(std::string("value out of range"));
+			}
+			n = (int)_value.i;
+			break;
+		case Reference:
+		case Link:
+			(*_value.target->resolved) >> n;
+			break;
+		default:
+			throw NodeException(std::string("type mismatch"));
+	}
 }
 
-void NodeObjMap::set_class_name(std::string name) {
-	_name = name;
+void Node::operator >>(long long &n) {
+	switch (_type) {
+		case Int:
+			n = _value.i;
+			break;
+		case Reference:
+		case Link:
+			(*_value.target->resolved) >> n;
+			break;
+		default:
+			throw NodeException(std::string("type mismatch"));
+	}
 }
 
-void NodeObjMap::print(int indent) {
-	for (int i = 0; i < indent; ++i) {
-		std::cout << " ";
-	}
-	std::cout << types[_type] << " ";
-	std::cout << "\"" << _name << "\" ";
-	std::cout << ":" << std::endl;
-	for (std::map<std::string,Node*>::iterator it = _map.begin(); it != _map.end(); ++it) {
-		(*it).second->print(indent+1);
+void Node::operator >>(double &x) {
+	switch (_type) {
+		case Float:
+			x = _value.x;
+			break;
+		case Reference:
+		case Link:
+			(*_value.target->resolved) >> x;
+			break;
+		default:
+			throw NodeException(std::string("type mismatch"));
 	}
 }
 
-std::string NodeObjSeq::get_class_name() {
-	return _name;
+void Node::operator >>(std::string &s) {
+	switch (_type) {
+		case String:
+			s.assign(_value.str, _length);
+			break;
+		case Reference:
+		case Link:
+			(*_value.target->resolved) >> s;
+			break;
+		default:
+			throw NodeException(std::string("type mismatch"));
+	}
 }
 
-void NodeObjSeq::set_class_name(std::string name) {
-	_name = name;
+void Node::operator >>(bool &b) {
+	switch (_type) {
+		case Boolean:
+			b = _value.b;
+			break;
+		case Reference:
+		case Link:
+			(*_value.target->resolved) >> b;
+			break;
+		default:
+			throw NodeException(std::string("type mismatch"));
+	}
 }
 
-void NodeObjSeq::print(int indent) {
+void Node::print_head(int indent) {
 	for (int i = 0; i < indent; ++i) {
 		std::cout << " ";
 	}
 	std::cout << types[_type] << " ";
-	std::cout << "\"" << _name << "\" ";
-	std::cout << ":" << std::endl;
-	for (std::vector<Node*>::iterator it = _seq.begin(); it != _seq.end(); ++it) {
-		(*it)->print(indent+1);
-	}
 }
 
-void NodeRef::set_target(std::string target) {
-	_target = target;
-}
-
-std::string NodeRef::get_target() {
-	return _target;
-}
-
-Node& NodeRef::operator [](size_type n) {
-	return get_anchor(_target)[n];
-}
-
-Node& NodeRef::operator [](std::string key) {
-	return get_anchor(_target)[key];
-}
-
-Node::size_type NodeRef::size() {
-	return get_anchor(_target).size();
+void Node::print(int indent) {
+	switch (_type) {
+		case String:
+			print_head(indent);
+			std::cout << "\"" << std::string_view(_value.str, _length) << "\"" << std::endl;
+			break;
+		case Int:
+			print_head(indent);
+			std::cout << _value.i << std::endl;
+			break;
+		case Float:
+			print_head(indent);
+			std::cout << _value.x << std::endl;
+			break;
+		case Boolean:
+			print_head(indent);
+			std::cout << (_value.b ? "true" : "false") << std::endl;
+			break;
+		case Map:
+		case ObjMap:
+		case Sequence:
+		case ObjSequence: {
+			iterator first = begin(), last = end();
+			print_head(indent);
+			if (_type == ObjMap || _type == ObjSequence) {
+				std::cout << "\"" << object_name() << "\" ";
+			}
+			std::cout << ":" << std::endl;
+			for (iterator it = first; it != last; ++it) {
+				(*it)->print(indent+1);
+			}
+			break;
+		}
+		case Reference:
+		case Link:
+			print_head(indent);
+			std::cout << "->" << get_target() << std::endl;
+			break;
+		default:
+			throw NodeException(std::string("attempting to print an invalid node"));
+	}
 }
 
-std::string NodeRef::get_class_name() {
-	return get_anchor(_target).get_class_name();
+Node::iterator Node::begin() {
+	switch (_type) {
+		case Map:
+		case ObjMap:
+			return iterator(entries().map.data());
+		case Sequence:
+		case ObjSequence:
+			return iterator(elements().seq.data());
+		case Reference:
+		case Link:
+			return _value.target->resolved->begin();
+		default:
+			throw NodeException(std::string("invalid access"));
+	}
 }
 
-void NodeRef::set_class_name(std::string name) {
-	get_anchor(_target).set_class_name(name);
+Node::iterator Node::end() {
+	switch (_type) {
+		case Map:
+		case ObjMap: {
+			map_type& map = entries().map;
+			return iterator(map.data() + map.size());
+		}
+		case Sequence:
+		case ObjSequence: {
+			seq_type& seq = elements().seq;
+			return iterator(seq.data() + seq.size());
+		}
+		case Reference:
+		case Link:
+			return _value.target->resolved->end();
+		default:
+			throw NodeException(std::string("invalid access"));
+	}
 }
 
-void NodeRef::operator >>(int &n) {
-	get_anchor(_target) >> n;
+// the length is kept in the node, which limits a string to 4 GB
+void Node::set_contents(std::string_view contents) {
+	if (_type != String) {
+		throw NodeException(std::string("invalid access"));
+	}
+	if (contents.size() > (size_type)-1) {
+		throw NodeException(std::string("string too long"));
+	}
+	_value.str = contents.data() ? contents.data() : "";
+	_length = (size_type)contents.size();
 }
 
-void NodeRef::operator >>(double &x) {
-	get_anchor(_target) >> x;
+void Node::set_target(std::string_view target) {
+	if (_type != Reference && _type != Link) {
+		throw NodeException(std::string("invalid access"));
+	}
+	_value.target->name = target.data();
+	_length = (size_type)target.size();
 }
 
-void NodeRef::operator >>(std::string &s) {
-	get_anchor(_target) >> s;
+std::string_view Node::get_target() {
+	if (_type != Reference && _type != Link) {
+		throw NodeException(std::string("invalid access"));
+	}
+	return std::string_view(_value.target->name, _length);
 }
 
-void NodeRef::operator >>(bool &b) {
-	get_anchor(_target) >> b;
+void Node::set_resolved(Node* target) {
+	if (_type != Reference && _type != Link) {
+		throw NodeException(std::string("invalid access"));
+	}
+	_value.target->resolved = target;
 }
 
-void NodeRef::print(int indent) {
-	for (int i = 0; i < indent; ++i) {
-		std::cout << " ";
+void Node::add_to_map(std::string_view key, Node *n) {
+	if (!is_map()) {
+		throw NodeException(std::string("type mismatch"));
 	}
-	std::cout << types[_type] << " ";
-	std::cout << "->" << _target << std::endl;
+	map_entry e;
+	e.key = key;
+	e.value = n;
+	_value.map->map.push_back(e);
 }
 
-void NodeLiteral::set_contents(std::string contents) {
-	_str = contents;
+static bool key_less(const Node::map_entry& a, const Node::map_entry& b) {
+	return a.key < b.key;
 }
 
-void NodeLiteral::print(int indent) {
-	for (int i = 0; i < indent; ++i) {
-		std::cout << " ";
+// called once the map is complete; orders the entries, builds the lookup
+// table and returns a key that occurs twice, or an empty view
+std::string_view Node::seal(bool keep_order) {
+	if (!is_map()) {
+		throw NodeException(std::string("type mismatch"));
 	}
-	std::cout << types[_type] << " ";
-	std::cout << _str << std::endl;
-}
-
-void NodeBool::operator >>(bool &b) {
-	std::stringstream stream(_str);
-	stream.setf(std::ios_base::boolalpha);
-	stream >> b;
+	map_type& map = _value.map->map;
+	if (!keep_order) {
+		std::sort(map.begin(), map.end(), key_less);
+	}
+	if (map.size() <= small_map_size) {
+		for (std::size_t i = 0; i < map.size(); ++i) {
+			for (std::size_t j = i + 1; j < map.size(); ++j) {
+				if (map[i].key.data() == map[j].key.data()) {
+					return map[i].key;
+				}
+			}
+		}
+		return std::string_view();
+	}
+	std::size_t slots = 16;
+	while (slots < 2 * map.size()) {
+		slots <<= 1;
+	}
+	std::pmr::memory_resource *mr = map.get_allocator().resource();
+	unsigned int *index = static_cast<unsigned int*>(mr->allocate(slots * sizeof(unsigned int), alignof(unsigned int)));
+	std::memset(index, 0, slots * sizeof(unsigned int));
+	_value.map->index = index;
+	_value.map->slots = (size_type)slots;
+	std::size_t mask = slots - 1;
+	for (std::size_t n = 0; n < map.size(); ++n) {
+		std::size_t i = key_hash(map[n].key) & mask;
+		for (; index[i] != 0; i = (i + 1) & mask) {
+			if (map[index[i] - 1].key.data() == map[n].key.data()) {
+				return map[n].key;
+			}
+		}
+		index[i] = (unsigned int)n + 1;
+	}
+	return std::string_view();
 }
 
-void NodeInt::operator >>(int &n) {
-	std::stringstream stream(_str);
-	stream.unsetf(std::ios_base::dec);
-	stream >> n;
+void Node::add_to_seq(Node *n) {
+	if (!is_seq()) {
+		throw NodeException(std::string("type mismatch"));
+	}
+	_value.seq->seq.push_back(n);
 }
 
-void NodeFloat::operator >>(double &x) {
-	std::stringstream stream(_str);
-	stream.unsetf(std::ios_base::dec);
-	stream >> x;
+void Node::defer(Parser* source, unsigned int span) {
+	if (!is_map() && !is_seq()) {
+		throw NodeException(std::string("type mismatch"));
+	}
+	members().source = source;
+	_length = span;
 }
 
-void NodeString::operator >>(std::string &s) {
-	s = _str;
+void Node::swap_members(Node* other) {
+	if (is_map()) {
+		_value.map->map.swap(other->_value.map->map);
+		std::swap(_value.map->index, other->_value.map->index);
+		std::swap(_value.map->slots, other->_value.map->slots);
+	} else if (is_seq()) {
+		_value.seq->seq.swap(other->_value.seq->seq);
+	} else {
+		throw NodeException(std::string("type mismatch"));
+	}
 }
 
-void NodeString::print(int indent) {
-	for (int i = 0; i < indent; ++i) {
-		std::cout << " ";
+// a container whose span fails to build stays deferred and throws again
+// the next time it is reached
+void Node::expand() {
+	Members& m = members();
+	Parser *source = m.source;
+	m.source = 0;
+	try {
+		source->expand(this, _length);
+	} catch (...) {
+		if (is_map()) {
+			_value.map->map.clear();
+			_value.map->index = 0;
+			_value.map->slots = 0;
+		} else {
+			_value.seq->seq.clear();
+		}
+		m.source = source;
+		throw;
 	}
-	std::cout << types[_type] << " ";
-	std::cout << "\"" << _str << "\"" << std::endl;
-}
\ No newline at end of file
+}
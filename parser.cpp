@@ -4,6 +4,15 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
+#include <charconv>
+#include <system_error>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <cstring>
 
 std::string types[] = {
 	"String","Int","Float",
@@ -17,177 +26,250 @@ std::string tokentypes[] = {
 	"IDENTIFIER","STRING","INT","FLOAT","BOOL"
 };
 
-Parser::Parser(std::istream& is):
-	_is(is), _iit(_is), _eos(), _skip_comments(true),
-	_document(), _generated(false), _cur_line(1)
+void Diagnostics::set_sink(Level level, Sink sink) {
+	_sink = sink;
+	_level = sink ? level : Diagnostics::Silent;
+}
+
+void Diagnostics::message(Level level, Channel channel, const std::string& text) {
+	if (enabled(level)) {
+		Record r;
+		r.level = level;
+		r.channel = channel;
+		r.phase = 0;
+		r.seconds = 0;
+		r.text = text;
+		_sink(r);
+	}
+}
+
+void Diagnostics::timing(const char* phase, double seconds) {
+	std::vector<std::pair<const char*,double> >::iterator it = _totals.begin();
+	while (it != _totals.end() && std::strcmp((*it).first, phase) != 0) {
+		++it;
+	}
+	if (it == _totals.end()) {
+		_totals.push_back(std::pair<const char*,double>(phase, seconds));
+	} else {
+		(*it).second += seconds;
+	}
+	if (enabled(Diagnostics::Info)) {
+		Record r;
+		r.level = Diagnostics::Info;
+		r.channel = Diagnostics::Phases;
+		r.phase = phase;
+		r.seconds = seconds;
+		r.text = phase;
+		_sink(r);
+	}
+}
+
+// two clock reads per phase, which is little enough to always keep them
+class PhaseTimer {
+	Diagnostics& _diag;
+	const char *_phase;
+	std::chrono::steady_clock::time_point _start;
+public:
+	PhaseTimer(Diagnostics& diag, const char* phase):
+		_diag(diag), _phase(phase), _start(std::chrono::steady_clock::now()) {}
+	void done() {
+		std::chrono::duration<double> d = std::chrono::steady_clock::now() - _start;
+		_diag.timing(_phase, d.count());
+	}
+};
+
+Parser::Parser(std::istream& is, std::pmr::memory_resource* upstream):
+	_generated(false), _input(is), _lexer(_input.begin(), _input.end()), _document(_input.size(), upstream),
+	_tok(0), _single_pass(false), _keep_key_order(false), _zero_copy(false),
+	_lazy(false), _next_span(0), _threads(1), _split(false), _depth(0), _whole(0),
+	_incremental(false), _base(0), _live(0), _value_start(0), _value_line(0), _closed_at(0),
+	_edit_begin(0), _edit_end(0), _edit_new_end(0), _edit_lines(0), _region_first(0), _region_last(0),
+	_stats(), _count_tokens(true)
+{
+	_diag.timing("read", _input.seconds());
+}
+
+Parser::Parser(const char* begin, const char* end, std::pmr::memory_resource* upstream):
+	_generated(false), _input(begin, end), _lexer(_input.begin(), _input.end()), _document(_input.size(), upstream),
+	_tok(0), _single_pass(false), _keep_key_order(false), _zero_copy(false),
+	_lazy(false), _next_span(0), _threads(1), _split(false), _depth(0), _whole(0),
+	_incremental(false), _base(0), _live(0), _value_start(0), _value_line(0), _closed_at(0),
+	_edit_begin(0), _edit_end(0), _edit_new_end(0), _edit_lines(0), _region_first(0), _region_last(0),
+	_stats(), _count_tokens(true)
+{
+	_diag.timing("read", _input.seconds());
+}
+
+Parser::Parser(const std::string& filename, InputBuffer::Mode mode, std::pmr::memory_resource* upstream):
+	_generated(false), _input(filename, mode), _lexer(_input.begin(), _input.end()), _document(_input.size(), upstream),
+	_tok(0), _single_pass(false), _keep_key_order(false), _zero_copy(false),
+	_lazy(false), _next_span(0), _threads(1), _split(false), _depth(0), _whole(0),
+	_incremental(false), _base(0), _live(0), _value_start(0), _value_line(0), _closed_at(0),
+	_edit_begin(0), _edit_end(0), _edit_new_end(0), _edit_lines(0), _region_first(0), _region_last(0),
+	_stats(), _count_tokens(true)
+{
+	_diag.timing("read", _input.seconds());
+}
+
+// a part of a split document; its lexer starts on the line of the cut
+Parser::Parser(Parser& whole, const char* begin, const char* end, unsigned int line):
+	_generated(false), _input(begin, end), _lexer(_input.begin(), _input.end()), _document(_input.size(), whole._document.upstream()),
+	_tok(0), _single_pass(true), _keep_key_order(whole._keep_key_order), _zero_copy(whole._zero_copy),
+	_lazy(false), _next_span(0), _threads(1), _split(false), _depth(0), _whole(&whole),
+	_incremental(false), _base(0), _live(0), _value_start(0), _value_line(0), _closed_at(0),
+	_edit_begin(0), _edit_end(0), _edit_new_end(0), _edit_lines(0), _region_first(0), _region_last(0),
+	_stats(), _count_tokens(true)
 {
-	_is >> std::noskipws;
+	_lexer.skip_to(begin, line);
 }
 
 Node& Parser::get_document() {
 	if (!_generated) {
-		lex();
-		print_tokens();
-		parse();
-		interpret();
+		if (BinaryCursor::is_binary(_input.begin(), _input.end())) {
+			decode();
+		} else if (_incremental) {
+			edit(0, _text.size(), std::string_view(_input.begin(), _input.size()));
+		} else if (_lazy) {
+			_single_pass = true; // a lazy document is lexed on demand
+			parse();
+			_count_tokens = false;
+			_lexer = Lexer(_input.begin(), _input.end());
+			interpret();
+		} else if (_threads > 1 && splittable()) {
+			_single_pass = true;
+			_split = true;
+			parse();
+			_split = false;
+			interpret_parts();
+			link_aliases();
+		} else if (_single_pass) {
+			interpret();
+		} else {
+			lex();
+			parse();
+			interpret();
+		}
 		_generated = true;
 	}
-	return *_document;
+	return _document.root();
 }
 
 void Parser::lex() {
-	static std::string char_tokens = "{}[]()!*@&:,";
-
-	while (_iit != _eos) {
-
-		if (char_tokens.find(*_iit) != std::string::npos) {
-			Token t;
-			t.line = _cur_line;
-			t.type = *_iit == '{' ? TOK_CBRACE_L :
-	 				 *_iit == '}' ? TOK_CBRACE_R :
-					 *_iit == '[' ? TOK_SBRACE_L :
-					 *_iit == ']' ? TOK_SBRACE_R :
-					 *_iit == '(' ? TOK_RBRACE_L :
-					 *_iit == ')' ? TOK_RBRACE_R :
-					 *_iit == '!' ? TOK_BANG :
-					 *_iit == '*' ? TOK_ASTERISK :
-					 *_iit == '@' ? TOK_AT :
-					 *_iit == '&' ? TOK_AMPERSAND :
-					 *_iit == ':' ? TOK_COLON :
-									TOK_COMMA;
-			t.contents += *_iit;
-			_token_list.push_back(t);
-			next_sym();
-
-		} else if (*_iit == '"') {
-			next_sym();
-			Token t;
-			t.line = _cur_line;
-			t.type = TOK_STRING;
-			bool escape = false, closed = false;
-			while (_iit != _eos && !closed) {
-				if (*_iit == '"') { // string termination
-					if (escape) { // unless escaped
-						escape = false;
-						t.contents += '"';
-					} else {
-						closed = true;
-					}
-				} else if (*_iit == '\\') { // escape character
-					if (escape) {
-						escape = false;
-						t.contents += '\\';
-					} else {
-						escape = true;
-					}
-				} else if (escape && *_iit == '#') { // comments can be escaped
-					t.contents += '#';
-					escape = false;
-				} else { // other characters
-					if (escape) {
-						escape = false;
-						t.contents += '\\';
-					}
-					t.contents += *_iit;
-				}
-				set_skip_comments(!escape);
-				next_sym();
-			}
-			if (!closed) {
-				throw LexException(t.line, std::string("unterminated string"));
-			}
-			_token_list.push_back(t);
-
-		} else if (is_an_identifier_letter(*_iit)) { // identifier
-			Token t;
-			t.type = TOK_IDENTIFIER;
-			t.line = _cur_line;
-			while (_iit != _eos && (is_an_identifier_letter(*_iit) || is_a_digit(*_iit))) {
-				t.contents += *_iit;
-				next_sym();
-			};
-			if (t.contents == "true" || t.contents == "false") {
-				t.type = TOK_BOOL;
-			}
-			_token_list.push_back(t);
-
-		} else if (is_a_digit(*_iit) || is_a_sign(*_iit) || *_iit == '.') {
-			Token t;
-			t.type = TOK_INT;
-			t.line = _cur_line;
-			if (_iit != _eos && is_a_sign(*_iit)) { // sign
-				t.contents += *_iit;
-				next_sym();
-			}
-			while (_iit != _eos && is_a_digit(*_iit)) { // integral part
-				t.contents += *_iit;
-				next_sym();
-			}
-			if (_iit != _eos && *_iit == '.') { // fractional part
-				t.type = TOK_FLOAT;
-				t.contents += *_iit;
-				next_sym();
-				while (_iit != _eos && is_a_digit(*_iit)) {
-					t.contents += *_iit;
-					next_sym();
-				}
-			}
-			if (_iit != _eos && (*_iit == 'e' || *_iit == 'E')) { // exponential part
-				t.contents += *_iit;
-				next_sym();
-				if (_iit != _eos && is_a_sign(*_iit)) {
-					t.contents += *_iit;
-					next_sym();
-				}
-				while (_iit != _eos && is_a_digit(*_iit)) {
-					t.contents += *_iit;
-					next_sym();
-				}
-			}
-			_token_list.push_back(t);
-
-		} else if (is_whitespace(*_iit)) {
-			next_sym();
-		} else {
-			throw LexException(_cur_line, std::string("invalid token")); // unknown token!
-		}
+	PhaseTimer timer(_diag, "lex");
+	Token t;
+	while (_lexer.lex_token(t)) {
+		_token_list.push_back(t);
+		count_token(t);
 	}
+	timer.done();
+}
+
+void Parser::set_single_pass(bool mode) {
+	_single_pass = mode;
+}
+
+void Parser::set_keep_key_order(bool mode) {
+	_keep_key_order = mode;
+}
+
+void Parser::set_zero_copy(bool mode) {
+	_zero_copy = mode;
+}
+
+void Parser::set_lazy(bool mode) {
+	_lazy = mode;
+}
 
-	std::cout << "Lexing A-OK!" << std::endl;
+void Parser::set_threads(unsigned int n) {
+	_threads = n ? n : std::thread::hardware_concurrency();
 }
 
-void Parser::set_skip_comments(bool mode) {
-	_skip_comments = mode;
+void Parser::set_incremental(bool mode) {
+	_incremental = mode;
 }
 
-void Parser::next_sym() {
-	if (_iit != _eos) {
-		if (*_iit == '\n') ++_cur_line;
-		++_iit;
+// the edit is what lies between the longest common prefix and suffix of
+// the kept text and the new one
+Node& Parser::update(const char* begin, const char* end) {
+	if (!_incremental) {
+		throw InputException(std::string("update needs an incremental parser"));
 	}
-	if (_skip_comments && _iit != _eos && *_iit == '#') {
-		do {
-			++_iit;
-		} while (_iit != _eos && *_iit != '\n');
-		if (*_iit == '\n') ++_cur_line;
-		++_iit;
+	std::size_t size = end - begin, limit = std::min(_text.size(), size);
+	std::size_t prefix = std::mismatch(_text.begin(), _text.begin() + limit, begin).first - _text.begin();
+	std::size_t suffix = std::mismatch(_text.rbegin(), _text.rbegin() + (limit - prefix), std::reverse_iterator<const char*>(end)).first - _text.rbegin();
+	if (_generated && prefix == limit && _text.size() == size) {
+		return _document.root();
+	}
+	edit(prefix, _text.size() - suffix - prefix, std::string_view(begin + prefix, size - suffix - prefix));
+	_generated = true;
+	return _document.root();
+}
+
+Node& Parser::update(std::size_t offset, std::size_t length, std::string_view replacement) {
+	if (!_incremental) {
+		throw InputException(std::string("update needs an incremental parser"));
+	}
+	get_document();
+	if (offset > _text.size() || length > _text.size() - offset) {
+		throw InputException(std::string("edit outside the text"));
 	}
+	edit(offset, length, replacement);
+	return _document.root();
 }
 
-bool Parser::is_a_digit(char c) {
-	return c >= '0' && c <= '9';
+void Parser::set_diagnostics(Diagnostics::Level level, Diagnostics::Sink sink) {
+	_diag.set_sink(level, sink);
 }
 
-bool Parser::is_a_sign(char c) {
-	return c == '+' || c == '-';
+// the counts kept elsewhere are gathered on demand; the nodes of a parallel
+// load are in the parts' documents
+const Parser::Stats& Parser::stats() {
+	_stats.bytes = _input.size();
+	_stats.allocated = _document.allocated();
+	for (int t = 0; t <= Node::Link; ++t) {
+		_stats.nodes[t] = _document.created()[t];
+	}
+	for (std::size_t i = 0; i < _parts.size(); ++i) {
+		Document& part = _parts[i]->_document;
+		_stats.allocated += part.allocated();
+		for (int t = 0; t <= Node::Link; ++t) {
+			_stats.nodes[t] += part.created()[t];
+		}
+		--_stats.nodes[part.root().get_type()]; // the container the whole took the members from
+	}
+	_stats.aliases = _document.anchors().size();
+	_stats.references = _stats.nodes[Node::Reference];
+	_stats.links = _stats.nodes[Node::Link];
+	_stats.seconds = _diag.totals();
+	return _stats;
 }
 
-bool Parser::is_an_identifier_letter(char c) {
-	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+void Parser::Stats::report(const std::function<void(const std::string&,double)>& f) const {
+	f("bytes", (double)bytes);
+	for (int t = 0; t <= TOK_BOOL; ++t) {
+		f("tokens." + tokentypes[t], (double)tokens[t]);
+	}
+	for (int t = 0; t <= Node::Link; ++t) {
+		f("nodes." + types[t], (double)nodes[t]);
+	}
+	f("aliases", (double)aliases);
+	f("references", (double)references);
+	f("links", (double)links);
+	f("depth", (double)depth);
+	f("allocated", (double)allocated);
+	for (std::size_t i = 0; i < seconds.size(); ++i) {
+		f(std::string("seconds.") + seconds[i].first, seconds[i].second);
+	}
 }
 
-bool Parser::is_whitespace(char c) {
-	return c == 0x09 || (c >= 0x0A && c <= 0x0D) || c == 0x20;
+// every token lexed for the document passes through here once
+void Parser::count_token(Token& t) {
+	if (_count_tokens) {
+		++_stats.tokens[t.type];
+	}
+	if (_diag.enabled(Diagnostics::Trace)) {
+		_diag.message(Diagnostics::Trace, Diagnostics::Tokens, tokentypes[t.type] + " | " + std::string(t.contents));
+	}
 }
 
 void Parser::print_tokens() {
@@ -197,9 +279,34 @@ void Parser::print_tokens() {
 }
 
 void Parser::parse() {
-	_cur_token = _token_list.begin();
+	PhaseTimer timer(_diag, "parse");
+	first_token();
 	parse_value();
-	std::cout << "Parsing A-OK!" << std::endl;
+	timer.done();
+}
+
+void Parser::first_token() {
+	if (_single_pass) {
+		_tok = _lexer.lex_token(_lookahead) ? &_lookahead : 0;
+		if (_tok) count_token(*_tok);
+	} else {
+		_cur_token = _token_list.begin();
+		_tok = _cur_token != _token_list.end() ? &*_cur_token : 0;
+	}
+}
+
+void Parser::next_token() {
+	if (_single_pass) {
+		_tok = _lexer.lex_token(_lookahead) ? &_lookahead : 0;
+		if (_tok) count_token(*_tok);
+	} else {
+		++_cur_token;
+		_tok = _cur_token != _token_list.end() ? &*_cur_token : 0;
+	}
+}
+
+unsigned int Parser::token_line() {
+	return _tok ? _tok->line : _lexer.line();
 }
 
 bool Parser::expect(TokenType t) {
@@ -207,71 +314,135 @@ bool Parser::expect(TokenType t) {
 		return true;
 	} else {
 		std::string str("unexpected token ");
-		str = str + tokentypes[(*_cur_token).type] + ", expected " + tokentypes[t];
-		throw ParseException((*_cur_token).line, str);
+		str = str + (_tok ? tokentypes[_tok->type] : std::string("end of input")) + ", expected " + tokentypes[t];
+		throw ParseException(token_line(), str);
 	}
 }
 
 bool Parser::accept(TokenType t) {
-	if (_cur_token != _token_list.end() && (*_cur_token).type == t) {
-		++_cur_token;
+	if (_tok && _tok->type == t) {
+		next_token();
 		return true;
 	}
 	return false;
 }
 
+// the view stays valid past the token: identifiers are never owned by it
+std::string_view Parser::expect_identifier() {
+	std::string_view name;
+	if (_tok) {
+		name = _tok->contents;
+	}
+	expect(TOK_IDENTIFIER);
+	return name;
+}
+
+// a part interns into the whole's pool, which is locked while shared;
+// names the part has seen before are found without taking the lock
+std::string_view Parser::intern(std::string_view name) {
+	if (!_whole) {
+		return _document.intern(name, _zero_copy);
+	}
+	std::unordered_set<std::string_view>::iterator it = _interned.find(name);
+	if (it != _interned.end()) {
+		return *it;
+	}
+	std::string_view s = _whole->intern(name);
+	_interned.insert(s);
+	return s;
+}
+
+StringPool* Parser::pool() {
+	return _whole ? &_whole->_document.strings() : &_document.strings();
+}
+
+// in lazy mode the grammar check also records the span of every container,
+// the edges between aliases, and a node for every aliased value, so that
+// nothing else has to be read before it is reached. a split document gets
+// the same edges and anchors, without nodes, and its cuts
 void Parser::parse_value() {
 	bool has_alias = false, is_ref = false;
+	std::string_view alias;
+	std::size_t mark = _pending.size(), span = _spans.size();
 	if (accept(TOK_AMPERSAND)) {
-		expect(TOK_IDENTIFIER);
+		alias = expect_identifier();
 		has_alias = true;
 	}
-	if (accept(TOK_CBRACE_L)) {
-		parse_map();
-	} else if (accept(TOK_SBRACE_L)) {
-		parse_seq();
+	if (_tok && _tok->type == TOK_CBRACE_L) {
+		open_span(Node::Map);
+		cut(0);
+		next_token();
+		parse_map(span);
+	} else if (_tok && _tok->type == TOK_SBRACE_L) {
+		open_span(Node::Sequence);
+		cut(0);
+		next_token();
+		parse_seq(span);
 	} else if (accept(TOK_BANG)) {
-		parse_obj();
+		parse_obj(span);
 	} else if (accept(TOK_ASTERISK)) {
 		if (has_alias) {
-			throw ParseException((*_cur_token).line, std::string("reference or link is aliased"));
+			throw ParseException(token_line(), std::string("reference or link is aliased"));
 		}
-		expect(TOK_IDENTIFIER);
+		std::string_view target = expect_identifier();
+		if (_lazy || _split) _pending.push_back(alias_id(intern(target)));
 		is_ref = true;
 	} else if (accept(TOK_AT)) {
 		if (has_alias) {
-			throw ParseException((*_cur_token).line, std::string("reference or link is aliased"));
+			throw ParseException(token_line(), std::string("reference or link is aliased"));
 		}
-		expect(TOK_IDENTIFIER);
+		std::string_view target = expect_identifier();
+		if (_lazy || _split) _pending.push_back(alias_id(intern(target)));
 		is_ref = true;
-	} else if (accept(TOK_BOOL) || accept(TOK_INT) || accept(TOK_FLOAT) || accept(TOK_STRING)) {
+	} else if (_tok && (_tok->type == TOK_STRING || _tok->type == TOK_INT ||
+		_tok->type == TOK_FLOAT || _tok->type == TOK_BOOL)) {
+		if (_lazy) _literal = *_tok;
+		next_token();
 	} else {
-		throw ParseException((*_cur_token).line, std::string("invalid value"));
+		throw ParseException(token_line(), std::string("invalid value"));
 	}
 	if (!has_alias && accept(TOK_AMPERSAND)) {
 		if (is_ref) {
-			throw ParseException((*_cur_token).line, std::string("reference or link is aliased"));
+			throw ParseException(token_line(), std::string("reference or link is aliased"));
+		}
+		alias = expect_identifier();
+		has_alias = true;
+	}
+	if (_split && has_alias && _depth == 0) {
+		_root_alias = alias;
+	}
+	if ((_lazy || _split) && has_alias) {
+		Node *n = !_lazy ? 0 : span < _spans.size() ? deferred(span) : interpret_literal(_literal);
+		std::string_view name = intern(alias);
+		if (_document.add_anchor(name, n)) {
+			_presets[alias.data()] = n;
+			add_alias_edges(alias_id(name), mark);
 		}
-		expect(TOK_IDENTIFIER);
 	}
 }
 
-void Parser::parse_map() {
-	if (!accept(TOK_CBRACE_R)) {
+void Parser::parse_map(std::size_t span) {
+	descend();
+	if (!_tok || _tok->type != TOK_CBRACE_R) {
 		do {
 			parse_pair();
-		} while (accept(TOK_COMMA));
-		expect(TOK_CBRACE_R);
+		} while (separator());
 	}
+	cut(1);
+	close_span(span, TOK_CBRACE_R);
+	--_depth;
 }
 
-void Parser::parse_seq() {
-	if (!accept(TOK_SBRACE_R)) {
+void Parser::parse_seq(std::size_t span) {
+	descend();
+	if (!_tok || _tok->type != TOK_SBRACE_R) {
 		do {
 			parse_value();
-		} while (accept(TOK_COMMA));
-		expect(TOK_SBRACE_R);
+		} while (separator());
 	}
+	cut(1);
+	close_span(span, TOK_SBRACE_R);
+	--_depth;
 }
 
 void Parser::parse_pair() {
@@ -280,209 +451,1227 @@ void Parser::parse_pair() {
 	parse_value();
 }
 
-void Parser::parse_obj() {
-	expect(TOK_IDENTIFIER);
+void Parser::parse_obj(std::size_t span) {
+	descend();
+	std::string_view name = expect_identifier();
+	open_span(Node::ObjMap); // an empty object is a map, as in interpret_obj
 	expect(TOK_RBRACE_L);
-	if (!accept(TOK_RBRACE_R)) {
-		if ((*_cur_token).type == TOK_IDENTIFIER) {
+	if (_lazy) _spans[span].name = name;
+	if (!_tok || _tok->type != TOK_RBRACE_R) {
+		if (_tok && _tok->type == TOK_IDENTIFIER) {
 			do {
 				parse_pair();
 			} while (accept(TOK_COMMA));
 		} else {
+			if (_lazy) _spans[span].type = Node::ObjSequence;
 			do {
 				parse_value();
 			} while (accept(TOK_COMMA));
 		}
-		expect(TOK_RBRACE_R);
 	}
+	close_span(span, TOK_RBRACE_R);
+	--_depth;
+}
+
+// _tok is the opening bracket
+void Parser::open_span(Node::NodeType type) {
+	if (_lazy && _tok) {
+		Span s;
+		s.begin = _tok->contents.data() + 1;
+		s.end = s.begin;
+		s.line = s.end_line = _tok->line;
+		s.next = 0;
+		s.type = type;
+		_spans.push_back(s);
+	}
+}
+
+void Parser::close_span(std::size_t span, TokenType t) {
+	if (_lazy && _tok && _tok->type == t) {
+		_spans[span].end = _tok->contents.data();
+		_spans[span].end_line = _tok->line;
+		_spans[span].next = (unsigned int)_spans.size();
+	}
+	expect(t);
+}
+
+TokenType Parser::closing(Node::NodeType type) {
+	return type == Node::Map ? TOK_CBRACE_R : type == Node::Sequence ? TOK_SBRACE_R : TOK_RBRACE_R;
+}
+
+bool Parser::separator() {
+	if (_tok && _tok->type == TOK_COMMA) {
+		cut(1);
+	}
+	return accept(TOK_COMMA);
+}
+
+// _tok is a bracket or comma; the root's opening bracket is found at depth
+// 0, its commas and closing bracket at depth 1
+void Parser::cut(unsigned int depth) {
+	if (_split && _depth == depth && _tok) {
+		_cuts.push_back(std::pair<const char*,unsigned int>(_tok->contents.data(), _tok->line));
+	}
+}
+
+// only a top level map or sequence, optionally aliased, is cut
+bool Parser::splittable() {
+	if (_input.size() < split_size) {
+		return false;
+	}
+	Lexer lexer(_input.begin(), _input.end());
+	Token t;
+	if (!lexer.lex_token(t)) {
+		return false;
+	}
+	if (t.type == TOK_AMPERSAND && !(lexer.lex_token(t) && t.type == TOK_IDENTIFIER && lexer.lex_token(t))) {
+		return false;
+	}
+	return t.type == TOK_CBRACE_L || t.type == TOK_SBRACE_L;
+}
+
+// the grammar check has already passed and recorded the aliases, so the
+// parts only build nodes. they are handed out to the threads one at a time,
+// which keeps every thread busy however uneven the parts turn out; the
+// members are then joined in document order and the anchors filled in
+void Parser::interpret_parts() {
+	PhaseTimer timer(_diag, "interpret");
+	bool pairs = *_cuts.front().first == '{';
+	std::size_t members = _cuts.size() - 1;
+	std::size_t count = std::min<std::size_t>(members, (std::size_t)_threads * parts_per_thread);
+	std::size_t share = (_cuts.back().first - _cuts.front().first) / count + 1;
+	for (std::size_t first = 0, i = 1; i <= members; ++i) {
+		if (i == members || (std::size_t)(_cuts[i].first - _cuts[first].first) >= share) {
+			_parts.push_back(std::unique_ptr<Parser>(new Parser(*this, _cuts[first].first + 1, _cuts[i].first, _cuts[first].second)));
+			first = i;
+		}
+	}
+
+	std::vector<std::exception_ptr> errors(_parts.size());
+	std::atomic<std::size_t> next(0);
+	std::function<void()> work = [&]() {
+		for (std::size_t i = next++; i < _parts.size(); i = next++) {
+			try {
+				_parts[i]->interpret_part(pairs);
+			} catch (...) {
+				errors[i] = std::current_exception();
+			}
+		}
+	};
+	_document.strings().set_shared(true);
+	std::vector<std::thread> workers;
+	for (std::size_t i = 1; i < _threads && i < _parts.size(); ++i) {
+		try {
+			workers.push_back(std::thread(work));
+		} catch (std::system_error&) {
+			break; // the threads already started share the work
+		}
+	}
+	work();
+	for (std::size_t i = 0; i < workers.size(); ++i) {
+		workers[i].join();
+	}
+	_document.strings().set_shared(false);
+	for (std::size_t i = 0; i < errors.size(); ++i) {
+		if (errors[i]) {
+			std::rethrow_exception(errors[i]); // the first error in the document
+		}
+	}
+
+	Node* root = pairs ? (Node*)_document.create<NodeMap>(pool()) : (Node*)_document.create<NodeSeq>();
+	for (std::size_t i = 0; i < _parts.size(); ++i) {
+		Parser& part = *_parts[i];
+		Node& built = part._document.root();
+		for (Node::iterator it = built.begin(); it != built.end(); ++it) {
+			if (pairs) {
+				root->add_to_map(it.key(), *it);
+			} else {
+				root->add_to_seq(*it);
+			}
+		}
+		for (std::size_t j = 0; j < part._anchored.size(); ++j) {
+			(*_document.anchors().find(part._anchored[j].first)).second = part._anchored[j].second;
+		}
+		_references.insert(_references.end(), part._references.begin(), part._references.end());
+	}
+	if (pairs) {
+		seal_map(root);
+	}
+	if (_presets.count(_root_alias.data())) {
+		(*_document.anchors().find(_root_alias)).second = root;
+	}
+	_document.set_root(root);
+	timer.done();
+}
+
+// the members between two cuts, into a container of the part's own that
+// the whole takes them from
+void Parser::interpret_part(bool pairs) {
+	Node* members = pairs ? (Node*)_document.create<NodeMap>(pool()) : (Node*)_document.create<NodeSeq>();
+	first_token();
+	if (_tok && pairs) {
+		do {
+			std::string_view key = intern(expect_identifier());
+			expect(TOK_COLON);
+			members->add_to_map(key, interpret_value());
+		} while (accept(TOK_COMMA));
+	} else if (_tok) {
+		interpret_elements(members);
+	}
+	_document.set_root(members);
 }
 
 void Parser::interpret() {
-	_cur_token = _token_list.begin();
-	_document = interpret_value();
+	PhaseTimer timer(_diag, "interpret");
+	first_token();
+	_document.set_root(interpret_value());
+	timer.done();
+	link_aliases();
+}
+
+void Parser::link_aliases() {
+	PhaseTimer cycle_timer(_diag, "cycles");
 	check_for_cycles();
-	std::cout << "Interpreting A-OK!" << std::endl;
+	cycle_timer.done();
+	PhaseTimer resolve_timer(_diag, "resolve");
+	if (_lazy) {
+		check_for_unknown_aliases(); // lazy references are resolved as they are built
+	} else {
+		resolve_references();
+	}
+	resolve_timer.done();
 }
 
+// the interpret_* methods check the same grammar as the parse_* methods,
+// so in single pass mode they are the only walk over the token stream.
+// in lazy mode they build one level only; nested containers are deferred
+// and aliased values take the node made for them by parse_value
 Node* Parser::interpret_value() {
-	Node* result;
+	Node* result = 0;
 	bool has_alias = false;
-	std::string alias;
+	std::string_view alias;
+	std::size_t mark = _pending.size();
+	const char *start = 0;
 	if (accept(TOK_AMPERSAND)) {
-		alias = (*_cur_token).contents;
+		alias = expect_identifier();
 		has_alias = true;
-		accept(TOK_IDENTIFIER);
 	}
-	if (accept(TOK_CBRACE_L)) {
+	if (_incremental && _tok) {
+		start = _value_start = _tok->contents.data();
+		_value_line = _tok->line;
+		if (_tok->type == TOK_CBRACE_L || _tok->type == TOK_SBRACE_L || _tok->type == TOK_BANG) {
+			result = reused();
+		}
+	}
+	if (result) {
+		// taken over from the previous text
+	} else if (_lazy && _tok && (_tok->type == TOK_CBRACE_L || _tok->type == TOK_SBRACE_L || _tok->type == TOK_BANG)) {
+		result = skip_container();
+	} else if (accept(TOK_CBRACE_L)) {
 		result = interpret_map();
 	} else if (accept(TOK_SBRACE_L)) {
 		result = interpret_seq();
 	} else if (accept(TOK_BANG)) {
 		result = interpret_obj();
 	} else if (accept(TOK_ASTERISK)) {
+		if (has_alias) {
+			throw ParseException(token_line(), std::string("reference or link is aliased"));
+		}
 		result = interpret_ref();
 	} else if (accept(TOK_AT)) {
+		if (has_alias) {
+			throw ParseException(token_line(), std::string("reference or link is aliased"));
+		}
 		result = interpret_link();
+	} else if (_tok && (_tok->type == TOK_STRING || _tok->type == TOK_INT ||
+		_tok->type == TOK_FLOAT || _tok->type == TOK_BOOL)) {
+		result = interpret_literal(*_tok);
+		next_token();
 	} else {
-		TokenType t = (*_cur_token).type;
-		switch(t) {
-			case TOK_FLOAT: result = new NodeFloat(); break;
-			case TOK_INT: result = new NodeInt(); break;
-			case TOK_BOOL: result = new NodeBool(); break;
-			case TOK_STRING:
-			default: result = new NodeString(); break;
-		}
-		result->set_contents((*_cur_token).contents);
-		_cur_token++;
+		throw ParseException(token_line(), std::string("invalid value"));
 	}
 	if (!has_alias && accept(TOK_AMPERSAND)) {
+		if (result->get_type() == Node::Reference || result->get_type() == Node::Link) {
+			throw ParseException(token_line(), std::string("reference or link is aliased"));
+		}
 		has_alias = true;
-		alias = (*_cur_token).contents;
-		accept(TOK_IDENTIFIER);
+		alias = expect_identifier();
+	}
+	if (has_alias && _lazy) {
+		std::unordered_map<const char*,Node*>::iterator it = _presets.find(alias.data());
+		if (it != _presets.end()) {
+			result = (*it).second;
+		}
+	} else if (has_alias && _whole) {
+		if (_whole->_presets.count(alias.data())) { // the first definition of the name
+			_anchored.push_back(std::pair<std::string_view,Node*>(intern(alias), result));
+		}
+	} else if (has_alias && _incremental) {
+		Node::NodeType type = result->get_type();
+		bool container = type == Node::Map || type == Node::Sequence || type == Node::ObjMap || type == Node::ObjSequence;
+		Mark m;
+		m.begin = container ? start - _base : alias.data() - _base;
+		m.end = container ? _closed_at : m.begin;
+		m.name = intern(alias);
+		m.node = result;
+		m.alias = true;
+		m.first = false;
+		m.id = m.parent = -1;
+		_fresh_marks.push_back(m);
+	} else if (has_alias) {
+		alias = intern(alias);
+		if (_document.add_anchor(alias, result)) {
+			add_alias_edges(alias_id(alias), mark);
+		}
+	}
+	return result;
+}
+
+Node* Parser::interpret_literal(Token& t) {
+	Node* result;
+	switch(t.type) {
+		case TOK_FLOAT: result = _document.create<NodeFloat>(to_float(t)); break;
+		case TOK_INT: result = _document.create<NodeInt>(to_int(t)); break;
+		case TOK_BOOL: result = _document.create<NodeBool>(t.contents == "true"); break;
+		case TOK_STRING:
+		default:
+			result = _document.create<NodeString>();
+			result->set_contents(_zero_copy && !t.owned ? t.contents : _document.copy(t.contents));
+			break;
+	}
+	return result;
+}
+
+// builds the same nodes interpret_value would from the binary form, with
+// anchors, references and links recorded for the same checks
+void Parser::decode() {
+	PhaseTimer timer(_diag, "decode");
+	BinaryCursor in(_input.begin(), _input.end());
+	in.header();
+	std::size_t count = in.count();
+	in.names.reserve(count);
+	for (std::size_t i = 0; i < count; ++i) {
+		in.names.push_back(intern(in.bytes(in.count())));
+	}
+	_document.set_root(decode_value(in));
+	if (!in.at_end()) {
+		throw InputException(std::string("trailing bytes after binary document"));
+	}
+	timer.done();
+	link_aliases();
+}
+
+Node* Parser::decode_value(BinaryCursor& in) {
+	Node* result;
+	std::string_view alias;
+	std::size_t mark = _pending.size();
+	unsigned char tag = in.byte();
+	if (tag == BIN_ANCHOR) {
+		alias = in.name();
+		tag = in.byte();
+		if (tag == BIN_ANCHOR || tag == BIN_REFERENCE || tag == BIN_LINK) {
+			throw InputException(std::string("misplaced anchor in binary document"));
+		}
+	}
+	switch (tag) {
+		case BIN_STRING: {
+			std::string_view s = in.bytes(in.count());
+			result = _document.create<NodeString>();
+			result->set_contents(_zero_copy ? s : _document.copy(s));
+			break;
+		}
+		case BIN_INT: result = _document.create<NodeInt>(in.zigzag()); break;
+		case BIN_FLOAT: result = _document.create<NodeFloat>(in.float64()); break;
+		case BIN_FALSE: result = _document.create<NodeBool>(false); break;
+		case BIN_TRUE: result = _document.create<NodeBool>(true); break;
+		case BIN_MAP:
+		case BIN_OBJMAP: {
+			if (tag == BIN_MAP) {
+				result = _document.create<NodeMap>(pool());
+			} else {
+				result = _document.create<NodeObjMap>(pool());
+				result->set_class_name(in.name());
+			}
+			std::size_t n = in.count();
+			descend();
+			if (_depth > BinaryCursor::max_depth) {
+				throw InputException(std::string("binary document nested too deeply"));
+			}
+			for (std::size_t i = 0; i < n; ++i) {
+				std::string_view key = in.name();
+				result->add_to_map(key, decode_value(in));
+			}
+			--_depth;
+			if (n) {
+				seal_map(result);
+			}
+			break;
+		}
+		case BIN_SEQUENCE:
+		case BIN_OBJSEQUENCE: {
+			if (tag == BIN_SEQUENCE) {
+				result = _document.create<NodeSeq>();
+			} else {
+				result = _document.create<NodeObjSeq>(pool());
+				result->set_class_name(in.name());
+			}
+			std::size_t n = in.count();
+			descend();
+			if (_depth > BinaryCursor::max_depth) {
+				throw InputException(std::string("binary document nested too deeply"));
+			}
+			for (std::size_t i = 0; i < n; ++i) {
+				result->add_to_seq(decode_value(in));
+			}
+			--_depth;
+			break;
+		}
+		case BIN_REFERENCE:
+		case BIN_LINK: {
+			if (tag == BIN_REFERENCE) {
+				result = _document.create<NodeRef>();
+			} else {
+				result = _document.create<NodeLink>();
+			}
+			_references.push_back(result);
+			std::string_view target = in.name();
+			_pending.push_back(alias_id(target));
+			result->set_target(target);
+			break;
+		}
+		default:
+			throw InputException(std::string("unknown tag in binary document"));
 	}
-	if (has_alias) {
-		result->add_as_anchor(alias);
+	if (alias.data() && _document.add_anchor(alias, result)) {
+		add_alias_edges(alias_id(alias), mark);
 	}
 	return result;
 }
 
+// locale independent conversions; the lexer guarantees at most a leading
+// sign followed by digits, a point and an exponent, in that order
+long long Parser::to_int(Token& t) {
+	const char *first = t.contents.data(), *last = first + t.contents.size();
+	if (first != last && *first == '+') {
+		++first;
+	}
+	long long value = 0;
+	std::from_chars_result r = std::from_chars(first, last, value, 10);
+	if (r.ec == std::errc::result_out_of_range) {
+		throw ParseException(t.line, std::string("integer out of range: ") + std::string(t.contents));
+	} else if (r.ec != std::errc() || r.ptr != last) {
+		throw ParseException(t.line, std::string("malformed number: ") + std::string(t.contents));
+	}
+	return value;
+}
+
+double Parser::to_float(Token& t) {
+	const char *first = t.contents.data(), *last = first + t.contents.size();
+	bool negative = false;
+	if (first != last && (*first == '+' || *first == '-')) {
+		negative = *first == '-';
+		++first;
+	}
+	double value = 0;
+	std::from_chars_result r = std::from_chars(first, last, value, std::chars_format::general);
+	if (r.ec == std::errc::result_out_of_range) {
+		throw ParseException(t.line, std::string("number out of range: ") + std::string(t.contents));
+	} else if (r.ec != std::errc() || r.ptr != last || first == last || *first == '-') {
+		throw ParseException(t.line, std::string("malformed number: ") + std::string(t.contents));
+	}
+	return negative ? -value : value;
+}
+
 Node* Parser::interpret_map() {
-	Node* result = new NodeMap();
-	if (!accept(TOK_CBRACE_R)) {
-			std::string key;
-		do {
-			key = (*_cur_token).contents;
-			accept(TOK_IDENTIFIER);
-			accept(TOK_COLON);
-			result->add_to_map(key, interpret_value());
-		} while (accept(TOK_COMMA));
-		accept(TOK_CBRACE_R);
+	Node* result = _document.create<NodeMap>(pool());
+	open_extent(_value_start, _value_line);
+	descend();
+	if (!_tok || _tok->type != TOK_CBRACE_R) {
+		interpret_pairs(result);
 	}
+	close_extent(TOK_CBRACE_R, result);
+	expect(TOK_CBRACE_R);
+	--_depth;
 	return result;
 }
 
+void Parser::interpret_pairs(Node* map) {
+	std::string_view key;
+	do {
+		key = intern(expect_identifier());
+		expect(TOK_COLON);
+		map->add_to_map(key, interpret_value());
+	} while (accept(TOK_COMMA));
+	seal_map(map);
+}
+
+void Parser::interpret_elements(Node* seq) {
+	do {
+		seq->add_to_seq(interpret_value());
+	} while (accept(TOK_COMMA));
+}
+
+void Parser::seal_map(Node* map) {
+	std::string_view duplicate = map->seal(_keep_key_order);
+	if (!duplicate.empty()) {
+		throw ParseException(token_line(), std::string("duplicate key " + std::string(duplicate)));
+	}
+}
+
 Node* Parser::interpret_seq() {
-	Node* result = new NodeSeq();
-	if (!accept(TOK_SBRACE_R)) {
-		do {
-			result->add_to_seq(interpret_value());
-		} while (accept(TOK_COMMA));
-		accept(TOK_SBRACE_R);
+	Node* result = _document.create<NodeSeq>();
+	open_extent(_value_start, _value_line);
+	descend();
+	if (!_tok || _tok->type != TOK_SBRACE_R) {
+		interpret_elements(result);
 	}
+	close_extent(TOK_SBRACE_R, result);
+	expect(TOK_SBRACE_R);
+	--_depth;
 	return result;
 }
 
 Node* Parser::interpret_obj() {
 	Node* result;
-	std::string class_name = (*_cur_token).contents;
-	accept(TOK_IDENTIFIER);
-	accept(TOK_RBRACE_L);
-	if (!accept(TOK_RBRACE_R)) {
-		if ((*_cur_token).type == TOK_IDENTIFIER) {
-			result = new NodeObjMap();
-			std::string key;
-			do {
-				key = (*_cur_token).contents;
-				accept(TOK_IDENTIFIER);
-				accept(TOK_COLON);
-				result->add_to_map(key, interpret_value());
-			} while (accept(TOK_COMMA));
-		} else {
-			result = new NodeObjSeq();
-			do {
-				result->add_to_seq(interpret_value());
-			} while (accept(TOK_COMMA));
-		}
-		accept(TOK_RBRACE_R);
+	std::string_view class_name = intern(expect_identifier());
+	open_extent(_tok ? _tok->contents.data() : 0, token_line());
+	expect(TOK_RBRACE_L);
+	descend();
+	if (_tok && _tok->type == TOK_RBRACE_R) {
+		result = _document.create<NodeObjMap>(pool()); // an empty object has no members to tell its kind
+	} else if (_tok && _tok->type == TOK_IDENTIFIER) {
+		result = _document.create<NodeObjMap>(pool());
+		interpret_pairs(result);
+	} else {
+		result = _document.create<NodeObjSeq>(pool());
+		interpret_elements(result);
 	}
+	close_extent(TOK_RBRACE_R, result);
+	expect(TOK_RBRACE_R);
+	--_depth;
 	result->set_class_name(class_name);
 	return result;
 }
 
 Node* Parser::interpret_link() {
-	Node* result = new NodeLink();
-	result->set_target((*_cur_token).contents);
-	accept(TOK_IDENTIFIER);
+	Node* result = _document.create<NodeLink>();
+	interpret_target(result);
 	return result;
 }
 
 Node* Parser::interpret_ref() {
-	Node* result = new NodeRef();
-	result->set_target((*_cur_token).contents);
-	accept(TOK_IDENTIFIER);
+	Node* result = _document.create<NodeRef>();
+	interpret_target(result);
 	return result;
 }
 
-void Parser::check_for_cycles() {
-	unsigned int alias_count = Node::_alias_table.size();
-	_graph = new bool*[alias_count];
-	for (unsigned int i = 0; i < alias_count; ++i) {
-		_graph[i] = new bool[alias_count];
-		for (unsigned int j = 0; j < alias_count; ++j) {
-			_graph[i][j] = false;
+// every anchor of a lazy document is known before any reference is built,
+// so those are resolved at once instead of being collected
+void Parser::interpret_target(Node* ref) {
+	std::string_view name = expect_identifier();
+	std::string_view target = intern(name);
+	ref->set_target(target);
+	if (_incremental) {
+		Mark m;
+		m.begin = m.end = name.data() - _base;
+		m.name = target;
+		m.node = ref;
+		m.alias = false;
+		m.first = false;
+		m.id = m.parent = -1;
+		_fresh_marks.push_back(m);
+	} else if (_lazy) {
+		Document::anchor_table::iterator it = _document.anchors().find(target);
+		if (it != _document.anchors().end()) {
+			ref->set_resolved((*it).second);
 		}
+	} else {
+		_references.push_back(ref);
+		if (!_whole) _pending.push_back(alias_id(target));
+	}
+}
+
+// a container of a lazy document, to be built from its span when reached
+Node* Parser::deferred(std::size_t span) {
+	Node* result;
+	switch (_spans[span].type) {
+		case Node::Map:
+			result = _document.create<NodeMap>(pool());
+			break;
+		case Node::Sequence:
+			result = _document.create<NodeSeq>();
+			break;
+		case Node::ObjMap:
+			result = _document.create<NodeObjMap>(pool());
+			result->set_class_name(_spans[span].name);
+			break;
+		case Node::ObjSequence:
+		default:
+			result = _document.create<NodeObjSeq>(pool());
+			result->set_class_name(_spans[span].name);
+			break;
+	}
+	result->defer(this, (unsigned int)span);
+	return result;
+}
+
+// _tok opens the container; the lexer jumps straight to its closing bracket
+Node* Parser::skip_container() {
+	std::size_t span = _next_span;
+	Node* result = deferred(span);
+	_lexer.skip_to(_spans[span].end, _spans[span].end_line);
+	_next_span = _spans[span].next;
+	next_token();
+	expect(closing(_spans[span].type));
+	return result;
+}
+
+// called by a deferred container the first time it is reached
+void Parser::expand(Node* n, unsigned int span) {
+	Span& s = _spans[span];
+	_lexer.skip_to(s.begin, s.line);
+	_next_span = span + 1;
+	first_token();
+	if (_tok && _tok->type != closing(s.type)) {
+		if (s.type == Node::Map || s.type == Node::ObjMap) {
+			interpret_pairs(n);
+		} else {
+			interpret_elements(n);
+		}
+	}
+	expect(closing(s.type));
+}
+
+// alias must be interned, its address is its identity
+int Parser::alias_id(std::string_view alias) {
+	std::unordered_map<const char*,int>::iterator it = _alias_ids.find(alias.data());
+	if (it != _alias_ids.end()) {
+		return (*it).second;
 	}
-	unsigned int cnt = 0;
-	for (std::map<std::string,Node*>::iterator it = Node::_alias_table.begin();
-		it != Node::_alias_table.end(); ++it) {
-		_ordering.insert(std::pair<std::string,unsigned int>((*it).first,cnt));
-		cnt++;
+	int id = (int)_alias_names.size();
+	_alias_ids.insert(std::pair<const char*,int>(alias.data(), id));
+	_alias_names.push_back(alias);
+	return id;
+}
+
+// an aliased value gets an edge to every reference, link and nested anchor
+// left on _pending since it started; those nested anchors carry the edges
+// of their own subtrees, so each reference is recorded exactly once
+void Parser::add_alias_edges(int from, std::size_t mark) {
+	for (std::size_t i = mark; i < _pending.size(); ++i) {
+		_alias_edges.push_back(std::pair<int,int>(from, _pending[i]));
 	}
-	for (std::map<std::string,Node*>::iterator it = Node::_alias_table.begin();
-		it != Node::_alias_table.end(); ++it) {
-		std::cout << "checking " << (*it).first << " for cyclical references..." << std::endl;
-		recursive_check((*it).second, (*it).first);
+	_pending.resize(mark);
+	_pending.push_back(from);
+}
+
+// from the given vertices only, or from all of them. an incremental parser
+// keeps the edges in a list by vertex, as it takes them out and puts them
+// back; otherwise they are bucketed by source vertex into one flat array
+void Parser::check_for_cycles(const std::vector<int>* roots) {
+	std::size_t vertex_count = _alias_ids.size();
+	std::vector<std::size_t> first;
+	std::vector<int> targets;
+	if (!_incremental) {
+		first.assign(vertex_count + 1, 0);
+		targets.resize(_alias_edges.size());
+		for (std::size_t i = 0; i < _alias_edges.size(); ++i) {
+			++first[_alias_edges[i].first + 1];
+		}
+		for (std::size_t v = 0; v < vertex_count; ++v) {
+			first[v + 1] += first[v];
+		}
+		std::vector<std::size_t> fill(first.begin(), first.end() - 1);
+		for (std::size_t i = 0; i < _alias_edges.size(); ++i) {
+			targets[fill[_alias_edges[i].first]++] = _alias_edges[i].second;
+		}
+
+		if (_diag.enabled(Diagnostics::Trace)) {
+			for (std::size_t i = 0; i < _alias_edges.size(); ++i) {
+				_diag.message(Diagnostics::Trace, Diagnostics::Cycles, "edge " +
+					std::string(_alias_names[_alias_edges[i].first]) + " -> " + std::string(_alias_names[_alias_edges[i].second]));
+			}
+		}
 	}
-	for (unsigned int i = 0; i < alias_count; ++i) {
-		for (unsigned int j = 0; j < alias_count; ++j) {
-			std::cout << _graph[i][j] << " ";
+	auto degree = [&](int v) {return _incremental ? _adjacent[v].size() : first[v + 1] - first[v];};
+	auto target = [&](int v, std::size_t n) {return _incremental ? _adjacent[v][n] : targets[first[v] + n];};
+
+	// iterative depth first search; 0 unvisited, 1 on the stack, 2 done.
+	// only the vertices reached are cleared for the next search
+	_color.resize(vertex_count, 0);
+	std::vector<int> reached;
+	std::vector<std::pair<int,std::size_t> > stack;
+	std::size_t root_count = roots ? roots->size() : vertex_count;
+	try {
+		for (std::size_t r = 0; r < root_count; ++r) {
+			int root = roots ? (*roots)[r] : (int)r;
+			if (_color[root] != 0) {
+				continue;
+			}
+			_color[root] = 1;
+			reached.push_back(root);
+			stack.push_back(std::pair<int,std::size_t>(root, 0));
+			while (!stack.empty()) {
+				int v = stack.back().first;
+				if (stack.back().second < degree(v)) {
+					int w = target(v, stack.back().second++);
+					if (_color[w] == 0) {
+						_color[w] = 1;
+						reached.push_back(w);
+						stack.push_back(std::pair<int,std::size_t>(w, 0));
+					} else if (_color[w] == 1) {
+						report_cycle(stack, w);
+					}
+				} else {
+					_color[v] = 2;
+					stack.pop_back();
+				}
+			}
+		}
+	} catch (...) {
+		for (std::size_t i = 0; i < reached.size(); ++i) {
+			_color[reached[i]] = 0;
 		}
-		std::cout << std::endl;
+		throw;
 	}
-	_color = new int[alias_count];
-	for (unsigned int i = 0; i < alias_count; ++i) {
-		_color[i] = 0;
+	for (std::size_t i = 0; i < reached.size(); ++i) {
+		_color[reached[i]] = 0;
 	}
-	for (unsigned int i = 0; i < alias_count; ++i) {
-		if (_color[i] == 0) {
-			dfs_visit(i);
+}
+
+void Parser::check_for_unknown_aliases() {
+	std::string names;
+	for (std::size_t i = 0; i < _alias_names.size(); ++i) {
+		if (_document.anchors().find(_alias_names[i]) == _document.anchors().end()) {
+			names += (names.empty() ? "" : ", ") + std::string(_alias_names[i]);
 		}
 	}
-	std::cout << "No cycles detected!" << std::endl;
+	if (!names.empty()) {
+		throw ValidateException(std::string("unknown alias: " + names));
+	}
 }
 
-void Parser::recursive_check(Node* n, std::string alias) {
-	std::cout << "searching node..." << std::endl;
-	n->print(3);
-	switch (n->get_type()) {
-		case Node::Map:
-		case Node::ObjMap:
-		case Node::Sequence:
-		case Node::ObjSequence:
-			for (Node::iterator it = n->begin(); it != n->end(); ++it) {
-				recursive_check((*it),alias);
-			};
-			break;
-		case Node::Reference:
-		case Node::Link:
-			std::cout << "found a link to " << n->get_target() << " from " << alias << "!" << std::endl;
-			_graph[_ordering[alias]][_ordering[n->get_target()]] = true;
-			break;
-		default:
-			break;
+void Parser::report_cycle(std::vector<std::pair<int,std::size_t> >& stack, int target) {
+	std::size_t start = stack.size() - 1;
+	while (stack[start].first != target) {
+		--start;
+	}
+	std::string path;
+	for (std::size_t i = start; i < stack.size(); ++i) {
+		path += std::string(_alias_names[stack[i].first]) + " -> ";
 	}
+	path += _alias_names[target];
+	throw ValidateException(std::string("cyclical reference or link: " + path));
 }
 
-void Parser::dfs_visit(int i) {
-	_color[i] = 1;
-	for (unsigned int j = 0; j < Node::_alias_table.size(); ++j) {
-		if (_graph[i][j]) {
-			if (_color[j] == 0) {
-				dfs_visit(j);
-			} else if (_color[j] == 1) {
-				throw ValidateException(std::string("cyclical reference or link"));
+// points every reference and link straight at the node it names, so reading
+// through one is a single pointer load; runs after the cycle check, which
+// guarantees that following references to references terminates
+void Parser::resolve_references() {
+	std::vector<std::string_view> unknown;
+	for (std::size_t i = 0; i < _references.size(); ++i) {
+		Node *ref = _references[i];
+		std::string_view target = ref->get_target();
+		Document::anchor_table::iterator it = _document.anchors().find(target);
+		if (it == _document.anchors().end()) {
+			if (std::find(unknown.begin(), unknown.end(), target) == unknown.end()) {
+				unknown.push_back(target);
 			}
+			continue;
+		}
+		Node *n = (*it).second;
+		while (n->get_type() == Node::Reference || n->get_type() == Node::Link) { // collapse chains
+			Node *next = n->resolve();
+			if (!next) {
+				it = _document.anchors().find(n->get_target());
+				if (it == _document.anchors().end()) {
+					break;
+				}
+				next = (*it).second;
+			}
+			n = next;
+		}
+		ref->set_resolved(n);
+	}
+	if (!unknown.empty()) {
+		std::string names;
+		for (std::size_t i = 0; i < unknown.size(); ++i) {
+			names += (i ? ", " : "") + std::string(unknown[i]);
+		}
+		throw ValidateException(std::string("unknown alias: " + names));
+	}
+}
+
+
+// the text is edited in place and put back when the update fails
+void Parser::edit(std::size_t offset, std::size_t length, std::string_view replacement) {
+	PhaseTimer timer(_diag, "interpret");
+	_single_pass = true;
+	_zero_copy = false; // the text the strings would point into is edited
+	_lazy = false; // every container is built, so that its extent is known
+	_threads = 1;
+	bool first = !_generated;
+	_edit_begin = offset;
+	_edit_end = offset + length;
+	_edit_new_end = offset + replacement.size();
+	_edit_lines = (long)std::count(replacement.begin(), replacement.end(), '\n') -
+		(long)std::count(_text.begin() + _edit_begin, _text.begin() + _edit_end, '\n');
+	std::string removed(_text, offset, length);
+	_text.replace(offset, length, replacement.data(), replacement.size());
+	try {
+		std::size_t e = enclosing();
+		Node *built = 0;
+		if (e == _extents.size() || !rebuild(e, built)) {
+			e = _extents.size();
+			rebuild(e, built);
 		}
+		timer.done();
+		commit(e, built);
+	} catch (...) {
+		_text.replace(offset, replacement.size(), removed);
+		throw;
+	}
+	if (first) {
+		_live = _document.allocated();
+	} else if (_document.allocated() - _live > _live) {
+		compact();
+	}
+	_document.changed();
+}
+
+// builds the whole text again into the released arena, which drops every
+// node the updates replaced; the text was accepted, so only running out of
+// memory can make this fail
+void Parser::compact() {
+	PhaseTimer timer(_diag, "compact");
+	_document.clear();
+	_alias_ids.clear();
+	_alias_names.clear();
+	_extents.clear();
+	_marks.clear();
+	_adjacent.clear();
+	_referrers.clear();
+	_definitions.clear();
+	_color.clear();
+	_edit_begin = _edit_end = 0;
+	_edit_new_end = _text.size();
+	_edit_lines = 0;
+	bool counting = _count_tokens;
+	_count_tokens = false; // the tokens of the updates are counted, not these
+	Node *built = 0;
+	rebuild(0, built);
+	_count_tokens = counting;
+	commit(0, built);
+	_live = _document.allocated();
+	timer.done();
+}
+
+// the innermost map or sequence whose members hold the whole edit, or past
+// the last extent when there is none. it is the last extent to open before
+// the edit or one that extent is a member of. an object is left to its
+// container, as an edit can turn one from a map into a sequence
+std::size_t Parser::enclosing() {
+	std::vector<Extent>::iterator it = std::upper_bound(_extents.begin(), _extents.end(), _edit_begin,
+		[](std::size_t at, const Extent& x) {return at < x.begin;});
+	int i = (int)(it - _extents.begin()) - 1;
+	while (i >= 0 && (_extents[i].end < _edit_end || (_extents[i].type != Node::Map && _extents[i].type != Node::Sequence))) {
+		i = _extents[i].parent;
 	}
-	_color[i] = 2;
-}
\ No newline at end of file
+	return i < 0 ? _extents.size() : (std::size_t)i;
+}
+
+// interprets the members of extent e again from the edited text, or the
+// whole document when e is past the last extent. false when the members no
+// longer end at the old closing bracket, as the edit changed which brackets
+// match
+bool Parser::rebuild(std::size_t e, Node*& built) {
+	_base = _text.data();
+	_lexer = Lexer(_base, _base + _text.size());
+	_fresh.clear();
+	_fresh_marks.clear();
+	_open.clear();
+	_kept.clear();
+	_depth = 0;
+	if (e == _extents.size()) {
+		_region_first = 0;
+		_region_last = _extents.size();
+		first_token();
+		built = interpret_value();
+		return true;
+	}
+	Extent& x = _extents[e];
+	TokenType t = closing(x.type);
+	_region_first = e + 1;
+	_region_last = x.next;
+	for (int i = (int)e; i >= 0; i = _extents[i].parent) { // the members are inside e and every container around it
+		++_depth;
+	}
+	_lexer.skip_to(_base + x.begin, x.line);
+	first_token();
+	built = x.type == Node::Map ? (Node*)_document.create<NodeMap>(pool()) : (Node*)_document.create<NodeSeq>();
+	if (_tok && _tok->type != t) {
+		if (x.type == Node::Map) {
+			interpret_pairs(built);
+		} else {
+			interpret_elements(built);
+		}
+	}
+	return _tok && _tok->type == t && (std::size_t)(_tok->contents.data() - _base) == moved(x.end);
+}
+
+// where an offset of the old text is in the new one; offsets inside the
+// edit are never asked for
+std::size_t Parser::moved(std::size_t at) {
+	return at >= _edit_end ? at - _edit_end + _edit_new_end : at;
+}
+
+unsigned int Parser::moved_line(unsigned int line, std::size_t at) {
+	return at >= _edit_end ? (unsigned int)(line + _edit_lines) : line;
+}
+
+// bracket opens the members of the value that starts at _value_start
+void Parser::open_extent(const char* bracket, unsigned int line) {
+	if (_incremental && bracket) {
+		Extent x;
+		x.start = _value_start - _base;
+		x.begin = bracket + 1 - _base;
+		x.end = x.begin;
+		x.line = x.end_line = line;
+		x.next = 0;
+		x.parent = _open.empty() ? -1 : (int)_open.back();
+		x.type = Node::Map;
+		x.node = 0;
+		_open.push_back((unsigned int)_fresh.size());
+		_fresh.push_back(x);
+	}
+}
+
+// _tok closes the container opened last
+void Parser::close_extent(TokenType t, Node* n) {
+	if (_incremental && _tok && _tok->type == t) {
+		Extent& x = _fresh[_open.back()];
+		x.end = _tok->contents.data() - _base;
+		x.end_line = _tok->line;
+		x.next = (unsigned int)_fresh.size();
+		x.type = n->get_type();
+		x.node = n;
+		_open.pop_back();
+		_closed_at = x.end;
+	}
+}
+
+// _tok starts a container; if it is one the edit left alone, wholly before
+// or wholly after it, the node is taken over with everything in it and the
+// lexer continues from its closing bracket
+Node* Parser::reused() {
+	std::size_t at = _tok->contents.data() - _base, old;
+	if (at < _edit_begin) {
+		old = at;
+	} else if (at >= _edit_new_end) {
+		old = at - _edit_new_end + _edit_end;
+	} else {
+		return 0;
+	}
+	std::vector<Extent>::iterator first = _extents.begin() + _region_first, last = _extents.begin() + _region_last;
+	std::vector<Extent>::iterator it = std::lower_bound(first, last, old,
+		[](const Extent& x, std::size_t start) {return x.start < start;});
+	if (it == last || (*it).start != old || (at < _edit_begin && (*it).end >= _edit_begin)) {
+		return 0;
+	}
+	std::size_t from = it - _extents.begin(), to = (*it).next;
+	long offset = (long)_fresh.size() - (long)from;
+	for (std::size_t i = from; i < to; ++i) {
+		Extent x = _extents[i];
+		x.line = moved_line(x.line, x.begin - 1);
+		x.end_line = moved_line(x.end_line, x.end);
+		x.start = moved(x.start);
+		x.begin = moved(x.begin - 1) + 1;
+		x.end = moved(x.end);
+		x.next = (unsigned int)(x.next + offset);
+		x.parent = i == from ? (_open.empty() ? -1 : (int)_open.back()) : (int)(x.parent + offset);
+		_fresh.push_back(x);
+	}
+	_kept.push_back(std::pair<std::size_t,std::size_t>((*it).start, (*it).end));
+	Extent& x = _fresh[from + offset];
+	_lexer.skip_to(_base + x.end, x.end_line);
+	next_token();
+	expect(closing(x.type));
+	_closed_at = x.end;
+	return x.node;
+}
+
+// the marks inside the members built again are replaced by those of the
+// edited text: the ones inside the containers taken over, moved, and the
+// fresh ones. while no alias they define is defined anywhere else, only the
+// edges, anchors and references of those marks change; otherwise every mark
+// is gathered again. everything is checked before anything is replaced, and
+// only the edges put back can have made a cycle
+void Parser::commit(std::size_t e, Node* built) {
+	bool whole = e == _extents.size();
+	std::size_t first = 0, last = _marks.size();
+	if (!whole) {
+		std::size_t from = _extents[e].begin, to = _extents[e].end;
+		first = std::lower_bound(_marks.begin(), _marks.end(), from,
+			[](const Mark& m, std::size_t at) {return m.end < at;}) - _marks.begin();
+		last = std::lower_bound(_marks.begin() + first, _marks.end(), to,
+			[](const Mark& m, std::size_t at) {return m.end < at;}) - _marks.begin();
+	}
+	std::vector<Mark> marks;
+	for (std::size_t i = first, k = 0; i < last; ++i) { // those inside a container taken over
+		while (k < _kept.size() && _kept[k].second < _marks[i].end) {
+			++k;
+		}
+		if (k < _kept.size() && _kept[k].first < _marks[i].begin && _marks[i].end < _kept[k].second) {
+			marks.push_back(_marks[i]);
+			marks.back().begin = moved(marks.back().begin);
+			marks.back().end = moved(marks.back().end);
+		}
+	}
+	marks.insert(marks.end(), _fresh_marks.begin(), _fresh_marks.end());
+	std::sort(marks.begin(), marks.end(), [](const Mark& a, const Mark& b) {return a.end < b.end;});
+	gather(marks, whole ? -1 : outer_alias(e));
+	std::size_t ids = _alias_names.size();
+	_adjacent.resize(ids);
+	_referrers.resize(ids);
+	_definitions.resize(ids, 0);
+	bool widened = !whole && !confined(first, last, marks);
+	if (widened) {
+		std::vector<Mark> all(_marks.begin(), _marks.begin() + first);
+		all.insert(all.end(), marks.begin(), marks.end());
+		for (std::size_t i = last; i < _marks.size(); ++i) {
+			all.push_back(_marks[i]);
+			all.back().begin = moved(all.back().begin);
+			all.back().end = moved(all.back().end);
+		}
+		marks.swap(all);
+		first = 0;
+		last = _marks.size();
+		gather(marks, -1);
+	}
+
+	// an alias named by a reference and no longer defined anywhere
+	std::unordered_map<int,std::pair<long,long> > change; // definitions and references, by alias
+	for (std::size_t i = first; i < last; ++i) {
+		std::pair<long,long>& c = change[_marks[i].id];
+		--(_marks[i].alias ? c.first : c.second);
+	}
+	for (std::size_t i = 0; i < marks.size(); ++i) {
+		std::pair<long,long>& c = change[marks[i].id];
+		++(marks[i].alias ? c.first : c.second);
+	}
+	std::vector<std::string_view> unknown;
+	for (std::size_t i = 0; i < marks.size() + (last - first); ++i) {
+		Mark& m = i < marks.size() ? marks[i] : _marks[first + i - marks.size()];
+		std::pair<long,long>& c = change[m.id];
+		if ((long)_definitions[m.id] + c.first == 0 && (long)_referrers[m.id].size() + c.second > 0 &&
+			std::find(unknown.begin(), unknown.end(), m.name) == unknown.end()) {
+			unknown.push_back(m.name);
+		}
+	}
+	if (!unknown.empty()) {
+		std::string names;
+		for (std::size_t i = 0; i < unknown.size(); ++i) {
+			names += (i ? ", " : "") + std::string(unknown[i]);
+		}
+		throw ValidateException(std::string("unknown alias: " + names));
+	}
+
+	// the edges of the marks replaced are taken out and those of the new
+	// ones put in, and taken out again if they make a cycle
+	for (std::size_t i = first; i < last; ++i) {
+		if (_marks[i].parent >= 0) {
+			remove_edge(_marks[i].parent, _marks[i].id);
+		}
+	}
+	std::vector<int> roots;
+	for (std::size_t i = 0; i < marks.size(); ++i) {
+		if (marks[i].parent >= 0) {
+			_adjacent[marks[i].parent].push_back(marks[i].id);
+			roots.push_back(marks[i].parent);
+			if (_diag.enabled(Diagnostics::Trace)) {
+				_diag.message(Diagnostics::Trace, Diagnostics::Cycles, "edge " +
+					std::string(_alias_names[marks[i].parent]) + " -> " + std::string(marks[i].name));
+			}
+		}
+	}
+	std::sort(roots.begin(), roots.end());
+	roots.erase(std::unique(roots.begin(), roots.end()), roots.end());
+	try {
+		PhaseTimer cycle_timer(_diag, "cycles");
+		check_for_cycles(&roots);
+		cycle_timer.done();
+	} catch (...) {
+		for (std::size_t i = 0; i < marks.size(); ++i) {
+			if (marks[i].parent >= 0) {
+				remove_edge(marks[i].parent, marks[i].id);
+			}
+		}
+		for (std::size_t i = first; i < last; ++i) {
+			if (_marks[i].parent >= 0) {
+				_adjacent[_marks[i].parent].push_back(_marks[i].id);
+			}
+		}
+		throw;
+	}
+
+	if (whole) {
+		_document.set_root(built);
+		_extents.swap(_fresh);
+	} else {
+		std::size_t end = _extents[e].next;
+		long diff = (long)_fresh.size() - (long)(end - e - 1);
+		_extents[e].node->swap_members(built);
+		for (int i = (int)e; i >= 0; i = _extents[i].parent) { // e and every container around it end later
+			Extent& x = _extents[i];
+			x.end_line = moved_line(x.end_line, x.end);
+			x.end = moved(x.end);
+			x.next = (unsigned int)(x.next + diff);
+		}
+		for (std::size_t j = 0; j < _fresh.size(); ++j) {
+			_fresh[j].next += (unsigned int)(e + 1);
+			_fresh[j].parent = _fresh[j].parent < 0 ? (int)e : _fresh[j].parent + (int)(e + 1);
+		}
+		_extents.erase(_extents.begin() + e + 1, _extents.begin() + end);
+		_extents.insert(_extents.begin() + e + 1, _fresh.begin(), _fresh.end());
+		for (std::size_t i = e + 1 + _fresh.size(); i < _extents.size(); ++i) { // those after it move
+			Extent& x = _extents[i];
+			x.line = moved_line(x.line, x.begin - 1);
+			x.end_line = moved_line(x.end_line, x.end);
+			x.start = moved(x.start);
+			x.begin = moved(x.begin - 1) + 1; // with its bracket, as an insertion right after it is inside
+			x.end = moved(x.end);
+			x.next = (unsigned int)(x.next + diff);
+			if (x.parent > (int)e) {
+				x.parent = (int)(x.parent + diff);
+			}
+		}
+	}
+
+	// the anchors and references of the marks replaced, then of the new ones;
+	// every reference to an alias defined either way is resolved again
+	std::vector<int> defined;
+	for (std::size_t i = first; i < last; ++i) {
+		Mark& m = _marks[i];
+		if (m.alias) {
+			--_definitions[m.id];
+			if (m.first) {
+				_document.anchors().erase(m.name);
+			}
+			defined.push_back(m.id);
+		} else {
+			std::vector<Node*>& r = _referrers[m.id];
+			r.erase(std::find(r.begin(), r.end(), m.node));
+		}
+	}
+	for (std::size_t i = 0; i < marks.size(); ++i) {
+		Mark& m = marks[i];
+		if (m.alias) {
+			++_definitions[m.id];
+			if (m.first) {
+				_document.add_anchor(m.name, m.node);
+			}
+			defined.push_back(m.id);
+		} else {
+			_referrers[m.id].push_back(m.node);
+		}
+	}
+	PhaseTimer resolve_timer(_diag, "resolve");
+	std::sort(defined.begin(), defined.end());
+	defined.erase(std::unique(defined.begin(), defined.end()), defined.end());
+	for (std::size_t i = 0; i < defined.size(); ++i) {
+		Document::anchor_table::iterator it = _document.anchors().find(_alias_names[defined[i]]);
+		std::vector<Node*>& r = _referrers[defined[i]];
+		for (std::size_t j = 0; j < r.size(); ++j) {
+			r[j]->set_resolved(it != _document.anchors().end() ? (*it).second : 0);
+		}
+	}
+	for (std::size_t i = 0; i < marks.size(); ++i) {
+		if (!marks[i].alias) {
+			marks[i].node->set_resolved((*_document.anchors().find(marks[i].name)).second);
+		}
+	}
+	resolve_timer.done();
+
+	if (whole || widened) {
+		_marks.swap(marks);
+	} else {
+		_marks.erase(_marks.begin() + first, _marks.begin() + last);
+		_marks.insert(_marks.begin() + first, marks.begin(), marks.end());
+		for (std::size_t i = first + marks.size(); i < _marks.size(); ++i) { // those after it move
+			_marks[i].begin = moved(_marks[i].begin);
+			_marks[i].end = moved(_marks[i].end);
+		}
+	}
+}
+
+// the alias of the innermost container around the members of e, e itself
+// included, that is the first definition of its name, or -1; a container's
+// alias ends where it does
+int Parser::outer_alias(std::size_t e) {
+	for (int i = (int)e; i >= 0; i = _extents[i].parent) {
+		std::vector<Mark>::iterator it = std::lower_bound(_marks.begin(), _marks.end(), _extents[i].end,
+			[](const Mark& m, std::size_t at) {return m.end < at;});
+		if (it != _marks.end() && (*it).end == _extents[i].end && (*it).alias && (*it).first) {
+			return (*it).id;
+		}
+	}
+	return -1;
+}
+
+// the same edges add_alias_edges records, from marks in the order their
+// values end, which is the order interpret_value finishes them: a mark is
+// an edge from the innermost first definition around it, or from outer
+void Parser::gather(std::vector<Mark>& marks, int outer) {
+	std::vector<std::size_t> pending;
+	std::unordered_set<int> defined;
+	for (std::size_t i = 0; i < marks.size(); ++i) {
+		Mark& m = marks[i];
+		m.id = alias_id(m.name);
+		m.parent = -1;
+		m.first = m.alias && defined.insert(m.id).second;
+		if (m.alias && !m.first) {
+			continue; // as add_anchor ignores it
+		}
+		if (m.first) {
+			std::size_t j = pending.size();
+			while (j > 0 && marks[pending[j - 1]].begin >= m.begin) {
+				--j;
+			}
+			for (std::size_t n = j; n < pending.size(); ++n) {
+				marks[pending[n]].parent = m.id;
+			}
+			pending.resize(j);
+		}
+		pending.push_back(i);
+	}
+	for (std::size_t n = 0; n < pending.size(); ++n) {
+		marks[pending[n]].parent = outer;
+	}
+}
+
+// whether no alias defined by the marks replaced, or by those replacing
+// them, is defined outside the marks replaced
+bool Parser::confined(std::size_t first, std::size_t last, const std::vector<Mark>& marks) {
+	std::unordered_map<int,unsigned int> inside;
+	for (std::size_t i = first; i < last; ++i) {
+		if (_marks[i].alias) {
+			++inside[_marks[i].id];
+		}
+	}
+	for (std::size_t i = 0; i < marks.size(); ++i) {
+		if (marks[i].alias) {
+			inside.insert(std::pair<int,unsigned int>(marks[i].id, 0));
+		}
+	}
+	for (std::unordered_map<int,unsigned int>::iterator it = inside.begin(); it != inside.end(); ++it) {
+		if (_definitions[(*it).first] != (*it).second) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void Parser::remove_edge(int from, int to) {
+	std::vector<int>& edges = _adjacent[from];
+	edges.erase(std::find(edges.begin(), edges.end(), to));
+}
@@ -7,298 +7,1511 @@
 #include <map>
 #include <iterator>
 #include <stdexcept>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <memory_resource>
+#include <unordered_map>
+#include <unordered_set>
+#include <string_view>
+#include <utility>
+#include <functional>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
 
 class LexException: public std::runtime_error {
 	unsigned int _line;
 public:
-	LexException(unsigned int l, std::string &t): std::runtime_error("LexException: " + t), _line(l) {}
+	LexException(unsigned int l, const std::string &t): std::runtime_error("LexException: " + t), _line(l) {}
 	unsigned int line() {return _line;}
 };
 
 class ParseException: public std::runtime_error {
 	unsigned int _line;
 public:
-	ParseException(unsigned int l, std::string &t): std::runtime_error("ParseException: " + t), _line(l) {}
+	ParseException(unsigned int l, const std::string &t): std::runtime_error("ParseException: " + t), _line(l) {}
 	unsigned int line() {return _line;}
 };
 
 class ValidateException: public std::runtime_error {
 public:
-	ValidateException(std::string &t): std::runtime_error("ValidateException: " + t) {}
+	ValidateException(const std::string &t): std::runtime_error("ValidateException: " + t) {}
 };
 
 class NodeException: public std::runtime_error {
 public:
-	NodeException(std::string &t): std::runtime_error("NodeException: " + t) {}
+	NodeException(const std::string &t): std::runtime_error("NodeException: " + t) {}
 };
 
+class InputException: public std::runtime_error {
+public:
+	InputException(const std::string &t): std::runtime_error("InputException: " + t) {}
+};
+
+class EmitException: public std::runtime_error {
+public:
+	EmitException(const std::string &t): std::runtime_error("EmitException: " + t) {}
+};
+
+class PathException: public std::runtime_error {
+public:
+	PathException(const std::string &t): std::runtime_error("PathException: " + t) {}
+};
+
+class BindException: public std::runtime_error {
+	unsigned int _line;
+public:
+	BindException(unsigned int l, const std::string &t): std::runtime_error("BindException: " + t), _line(l) {}
+	unsigned int line() {return _line;}
+};
+
+// contiguous view of a whole document; either owns a copy of the bytes,
+// maps the file read-only, or borrows a caller's buffer that must outlive it
+class InputBuffer {
+public:
+	enum Mode {
+		Borrowed,Buffered,Mapped
+	};
+	InputBuffer(std::istream& is);
+	InputBuffer(const char* begin, const char* end);
+	InputBuffer(const std::string& filename, Mode mode);
+	~InputBuffer();
+	Mode mode() {return _mode;}
+	const char* begin() {return _begin;}
+	const char* end() {return _end;}
+	std::size_t size() {return _end - _begin;}
+	// how long reading the input took; a mapping is only paged in as it is read
+	double seconds() {return _seconds;}
+	// a mapping that is read at random rather than front to back
+	void set_random_access();
+private:
+	Mode _mode;
+	const char *_begin, *_end;
+	std::vector<char> _buffer;
+	void *_mapping;
+	std::size_t _mapping_size;
+	double _seconds;
+	InputBuffer(const InputBuffer&);
+	InputBuffer& operator=(const InputBuffer&);
+	void set_range();
+};
+
+class Parser;
+class StringPool;
+
+// a node is sixteen bytes: its type, a length and one word, which holds a
+// number or a boolean in place, or points at a string's characters, at
+// the members of a container or at the target of a reference. the members
+// and targets are kept out of line in the document's arena. there is no
+// virtual table; each call switches on the type
 class Node {
 public:
 	enum NodeType {
 		String,Int,Float,Boolean,Map,Sequence,ObjMap,ObjSequence,Reference,Link
 	};
 	typedef unsigned int size_type;
+	struct map_entry {
+		std::string_view key;
+		Node *value;
+	};
+	typedef std::pmr::vector<map_entry> map_type;
+	typedef std::pmr::vector<Node*> seq_type;
 	class iterator;
 	friend class Parser;
+	friend class Emitter;
+	friend class Encoder;
+	friend class ImageWriter;
 	NodeType _type;
 protected:
-	static std::map<std::string,Node*> _alias_table;
+	// the members of a container, kept out of line; an object's also hold
+	// its class name
+	struct Members {
+		Parser *source; // set while the members are deferred
+		Members(): source(0) {}
+	};
+	// entries are contiguous; small maps are scanned, larger ones get an
+	// open addressing table of entry positions once they are sealed.
+	// the table hashes the key bytes, so a lookup need not intern its key
+	struct MapMembers: public Members {
+		StringPool *pool;
+		map_type map;
+		unsigned int *index;
+		size_type slots;
+		MapMembers(std::pmr::memory_resource* mr, StringPool* p): pool(p), map(mr), index(0), slots(0) {}
+	};
+	struct SeqMembers: public Members {
+		seq_type seq;
+		SeqMembers(std::pmr::memory_resource* mr): seq(mr) {}
+	};
+	struct ObjMapMembers: public MapMembers {
+		std::string_view name;
+		ObjMapMembers(std::pmr::memory_resource* mr, StringPool* p): MapMembers(mr, p) {}
+	};
+	struct ObjSeqMembers: public SeqMembers {
+		StringPool *pool;
+		std::string_view name;
+		ObjSeqMembers(std::pmr::memory_resource* mr, StringPool* p): SeqMembers(mr), pool(p) {}
+	};
+	struct Target {
+		const char *name; // interned
+		Node *resolved;
+		Target(): name(0), resolved(0) {}
+	};
+	static const size_type small_map_size = 8;
+	// of a string or a target's name, or the span of deferred members
+	size_type _length;
+	union {
+		long long i;
+		double x;
+		bool b;
+		const char *str; // into the document's arena or its input
+		MapMembers *map;
+		SeqMembers *seq;
+		Target *target;
+	} _value;
+	template<class T, class... Args> static T* out_of_line(std::pmr::memory_resource* mr, Args&&... args) {
+		return new (mr->allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
 public:
-	Node(NodeType type=Node::String): _type(type) {}
+	Node(NodeType type=Node::String): _type(type), _length(0) {_value.i = 0;}
 	NodeType get_type() {return _type;}
-	virtual Node& operator[](size_type n);
-	virtual Node& operator[](std::string key);
-	virtual size_type size();
-	virtual std::string get_class_name();
-	virtual void set_class_name(std::string name);
-	virtual void operator>>(int &n);
-	virtual void operator>>(double &x);
-	virtual void operator>>(std::string &s);
-	virtual void operator>>(bool &b);
-	virtual void print(int indent);
-	virtual iterator begin();
-	virtual iterator end();
+	Node& operator[](size_type n);
+	Node& operator[](std::string_view key);
+	Node* find(std::string_view key);
+	// key must come from the document's string pool
+	Node* find_interned(std::string_view key);
+	size_type size();
+	std::string get_class_name();
+	// the interned class name of an object, empty for any other node
+	std::string_view class_name();
+	void set_class_name(std::string_view name);
+	void operator>>(int &n);
+	void operator>>(long long &n);
+	void operator>>(double &x);
+	void operator>>(std::string &s);
+	void operator>>(bool &b);
+	void print(int indent);
+	iterator begin();
+	iterator end();
+	// the node a reference or link stands for, or the node itself
+	Node* resolve() {return _type == Reference || _type == Link ? _value.target->resolved : this;}
 protected:
-	virtual void set_contents(std::string contents);
-	virtual void set_target(std::string target);
-	virtual std::string get_target();
-	virtual void add_to_map(std::string key, Node* n);
-	virtual void add_to_seq(Node* n);
-	static Node& get_anchor(std::string alias);
-	void add_as_anchor(std::string alias);
-};
-
-class iterNodeImpl;
-class iterNodeMapImpl;
-class iterNodeSeqImpl;
-
-class iterNodeImpl {
-public:
-	virtual iterNodeImpl* clone() = 0;
-	virtual void increment() = 0;
-	virtual bool equals(iterNodeImpl& rhs) = 0;
-	virtual bool equal_accept(iterNodeMapImpl& rhs) = 0;
-	virtual bool equal_accept(iterNodeSeqImpl& rhs) = 0;
-	virtual Node* dereference() = 0;
+	void set_contents(std::string_view contents);
+	void set_target(std::string_view target);
+	std::string_view get_target();
+	void set_resolved(Node* target);
+	// key must be interned in the document's pool
+	void add_to_map(std::string_view key, Node* n);
+	std::string_view seal(bool keep_order);
+	void add_to_seq(Node* n);
+	// leaves the members to be read from a span of the parser's input
+	void defer(Parser* source, unsigned int span);
+	// exchanges the members with another container of the same type
+	void swap_members(Node* other);
+private:
+	bool is_map() {return _type == Map || _type == ObjMap;}
+	bool is_seq() {return _type == Sequence || _type == ObjSequence;}
+	Members& members() {return is_map() ? (Members&)*_value.map : (Members&)*_value.seq;}
+	std::string_view& object_name() {
+		return _type == ObjMap ? static_cast<ObjMapMembers*>(_value.map)->name : static_cast<ObjSeqMembers*>(_value.seq)->name;
+	}
+	// the members of a container, built first when they were deferred
+	MapMembers& entries() {
+		if (_value.map->source) expand();
+		return *_value.map;
+	}
+	SeqMembers& elements() {
+		if (_value.seq->source) expand();
+		return *_value.seq;
+	}
+	Node* lookup(std::string_view key, bool interned);
+	void expand();
+	void print_head(int indent);
 };
 
-class iterNodeMapImpl: public iterNodeImpl {
-	std::map<std::string,Node*>::iterator it;
-public:
-	iterNodeMapImpl(std::map<std::string,Node*>::iterator iter);
-	iterNodeMapImpl(const iterNodeMapImpl& rhs);
-	iterNodeImpl* clone();
-	void increment();
-	bool equals(iterNodeImpl& rhs);
-	bool equal_accept(iterNodeMapImpl& rhs);
-	bool equal_accept(iterNodeSeqImpl& rhs);
-	Node* dereference();
-};
+class Document;
 
-class iterNodeSeqImpl: public iterNodeImpl {
-	std::vector<Node*>::iterator it;
+// identifiers of one document are stored once; equal names share a pointer,
+// so once interned they are compared and hashed by address
+class StringPool {
+	std::pmr::memory_resource *_mr;
+	std::pmr::unordered_set<std::string_view> _strings;
+	std::mutex _lock;
+	bool _shared;
 public:
-	iterNodeSeqImpl(std::vector<Node*>::iterator iter);
-	iterNodeSeqImpl(const iterNodeSeqImpl& rhs);
-	iterNodeImpl* clone();
-	void increment();
-	bool equals(iterNodeImpl& rhs);
-	bool equal_accept(iterNodeMapImpl& rhs);
-	bool equal_accept(iterNodeSeqImpl& rhs);
-	Node* dereference();
+	StringPool(std::pmr::memory_resource* mr): _mr(mr), _strings(mr), _shared(false) {}
+	// a borrowed s is kept as it is on first sight rather than copied, so
+	// it must stay valid for as long as the pool
+	std::string_view intern(std::string_view s, bool borrow = false);
+	// the interned copy of s, or an empty view if s was never interned
+	std::string_view find(std::string_view s);
+	std::size_t size() {return _strings.size();}
+	// while shared, intern may be called from several threads at once
+	void set_shared(bool shared) {_shared = shared;}
+private:
+	std::string_view insert(std::string_view s, bool borrow);
+	StringPool(const StringPool&);
+	StringPool& operator=(const StringPool&);
 };
 
+// a position in a map's entries or a sequence's elements; both are
+// contiguous, so it is a tagged pointer and needs no allocation
 class Node::iterator {
-	iterNodeImpl *_impl;
+	enum Kind {
+		SeqKind,MapKind
+	};
+	Kind _kind;
+	union {
+		Node::map_entry *map;
+		Node **seq;
+	} _at;
 public:
-	iterator();
-	iterator(std::map<std::string,Node*>::iterator iter);
-	iterator(std::vector<Node*>::iterator iter);
-	iterator(const iterator& rhs);
-	iterator& operator=(const iterator& rhs);
-	~iterator();
-	iterator& operator++();
-	iterator operator++(int);
-	bool operator==(const iterator& rhs);
-	bool operator!=(const iterator& rhs);
-	Node* operator*();
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef Node* value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef Node* const* pointer;
+	typedef Node* const& reference;
+	iterator(): _kind(SeqKind) {_at.seq = 0;}
+	explicit iterator(Node::map_entry* e): _kind(MapKind) {_at.map = e;}
+	explicit iterator(Node** n): _kind(SeqKind) {_at.seq = n;}
+	reference operator*() const {return _kind == MapKind ? _at.map->value : *_at.seq;}
+	pointer operator->() const {return &**this;}
+	reference operator[](difference_type n) const {return *(*this + n);}
+	// the key of a map entry, empty for sequence elements
+	std::string_view key() const {return _kind == MapKind ? _at.map->key : std::string_view();}
+	iterator& operator+=(difference_type n) {
+		if (_kind == MapKind) _at.map += n; else _at.seq += n;
+		return *this;
+	}
+	iterator& operator-=(difference_type n) {return *this += -n;}
+	iterator& operator++() {return *this += 1;}
+	iterator& operator--() {return *this += -1;}
+	iterator operator++(int) {iterator tmp(*this); *this += 1; return tmp;}
+	iterator operator--(int) {iterator tmp(*this); *this += -1; return tmp;}
+	iterator operator+(difference_type n) const {iterator tmp(*this); return tmp += n;}
+	iterator operator-(difference_type n) const {iterator tmp(*this); return tmp += -n;}
+	friend iterator operator+(difference_type n, const iterator& it) {return it + n;}
+	difference_type operator-(const iterator& rhs) const {
+		return _kind == MapKind ? _at.map - rhs._at.map : _at.seq - rhs._at.seq;
+	}
+	bool operator==(const iterator& rhs) const {
+		return _kind == rhs._kind && (_kind == MapKind ? _at.map == rhs._at.map : _at.seq == rhs._at.seq);
+	}
+	bool operator!=(const iterator& rhs) const {return !(*this == rhs);}
+	bool operator<(const iterator& rhs) const {return *this - rhs < 0;}
+	bool operator>(const iterator& rhs) const {return rhs < *this;}
+	bool operator<=(const iterator& rhs) const {return !(rhs < *this);}
+	bool operator>=(const iterator& rhs) const {return !(*this < rhs);}
 };
 
+// the kinds of node add no data; each only sets up what its type keeps
 class NodeMap: public Node {
-protected:
-	std::map<std::string,Node*> _map;
 public:
-	NodeMap(Node::NodeType type = Node::Map): Node(type) {}
-	Node& operator[](std::string key);
-	size_type size();
-	void add_to_map(std::string key, Node* n);
-	iterator begin();
-	iterator end();
-	virtual void print(int indent);
+	NodeMap(std::pmr::memory_resource* mr, StringPool* pool, Node::NodeType type = Node::Map): Node(type) {
+		_value.map = type == Node::ObjMap ? out_of_line<ObjMapMembers>(mr, mr, pool) : out_of_line<MapMembers>(mr, mr, pool);
+	}
 };
 
 class NodeSeq: public Node {
-protected:
-	std::vector<Node*> _seq;
 public:
-	NodeSeq(Node::NodeType type = Node::Sequence): Node(type) {}
-	Node& operator[](size_type n);
-	size_type size();
-	void add_to_seq(Node *n);
-	iterator begin();
-	iterator end();
-	virtual void print(int indent);
+	NodeSeq(std::pmr::memory_resource* mr, Node::NodeType type = Node::Sequence, StringPool* pool = 0): Node(type) {
+		_value.seq = type == Node::ObjSequence ? out_of_line<ObjSeqMembers>(mr, mr, pool) : out_of_line<SeqMembers>(mr, mr);
+	}
 };
 
 class NodeObjMap: public NodeMap {
-protected:
-	std::string _name;
 public:
-	NodeObjMap(): NodeMap(Node::ObjMap) {}
-	std::string get_class_name();
-	void set_class_name(std::string name);
-	void print(int indent);
+	NodeObjMap(std::pmr::memory_resource* mr, StringPool* pool): NodeMap(mr, pool, Node::ObjMap) {}
 };
 
 class NodeObjSeq: public NodeSeq {
-protected:
-	std::string _name;
 public:
-	NodeObjSeq(): NodeSeq(Node::ObjSequence) {}
-	std::string get_class_name();
-	void set_class_name(std::string name);
-	void print(int indent);
+	NodeObjSeq(std::pmr::memory_resource* mr, StringPool* pool): NodeSeq(mr, Node::ObjSequence, pool) {}
 };
 
 class NodeRef: public Node {
-protected:
-	std::string _target;
-	void set_target(std::string target);
-	std::string get_target();
 public:
-	NodeRef(Node::NodeType type = Node::Reference): Node(type) {}
-	Node& operator[](size_type n);
-	Node& operator[](std::string key);
-	size_type size();
-	std::string get_class_name();
-	void set_class_name(std::string name);
-	void operator>>(int &n);
-	void operator>>(double &x);
-	void operator>>(std::string &s);
-	void operator>>(bool &b);
-	void print(int indent);
+	NodeRef(std::pmr::memory_resource* mr, Node::NodeType type = Node::Reference): Node(type) {
+		_value.target = out_of_line<Target>(mr);
+	}
 };
 
 class NodeLink: public NodeRef {
 public:
-	NodeLink(): NodeRef(Node::Link) {}
+	NodeLink(std::pmr::memory_resource* mr): NodeRef(mr, Node::Link) {}
 };
 
+// numbers and booleans are converted once by the parser and kept natively
 class NodeLiteral: public Node {
-protected:
-	std::string _str;
-	void set_contents(std::string contents);
 public:
 	NodeLiteral(Node::NodeType type = Node::String): Node(type) {}
-	virtual void print(int indent);
 };
 
 class NodeBool: public NodeLiteral {
 public:
-	NodeBool(): NodeLiteral(Node::Boolean) {}
-	void operator>>(bool &b);
+	NodeBool(std::pmr::memory_resource*, bool value): NodeLiteral(Node::Boolean) {_value.b = value;}
 };
 
 class NodeInt: public NodeLiteral {
 public:
-	NodeInt(): NodeLiteral(Node::Int) {}
-	void operator>>(int &n);
+	NodeInt(std::pmr::memory_resource*, long long value): NodeLiteral(Node::Int) {_value.i = value;}
 };
 
 class NodeFloat: public NodeLiteral {
 public:
-	NodeFloat(): NodeLiteral(Node::Float) {}
-	void operator>>(double &x);
+	NodeFloat(std::pmr::memory_resource*, double value): NodeLiteral(Node::Float) {_value.x = value;}
 };
 
 class NodeString: public NodeLiteral {
 public:
-	NodeString(): NodeLiteral(Node::String) {}
-	void operator>>(std::string &s);
-	void print(int indent);
+	NodeString(std::pmr::memory_resource*): NodeLiteral(Node::String) {_value.str = "";}
 };
 
-class Parser {
-	enum TokenType {
-		TOK_CBRACE_L,
-		TOK_CBRACE_R,
-		TOK_SBRACE_L,
-		TOK_SBRACE_R,
-		TOK_RBRACE_L,
-		TOK_RBRACE_R,
-		TOK_BANG,
-		TOK_ASTERISK,
-		TOK_AT,
-		TOK_AMPERSAND,
-		TOK_COLON,
-		TOK_COMMA,
-		TOK_IDENTIFIER,
-		TOK_STRING,
-		TOK_INT,
-		TOK_FLOAT,
-		TOK_BOOL
+// passes allocations through to another resource, counting the bytes
+class CountingResource: public std::pmr::memory_resource {
+	std::pmr::memory_resource *_upstream;
+	std::size_t _bytes;
+public:
+	CountingResource(std::pmr::memory_resource* upstream): _upstream(upstream), _bytes(0) {}
+	std::pmr::memory_resource* upstream() {return _upstream;}
+	// allocated and not yet released
+	std::size_t bytes() {return _bytes;}
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment);
+	void do_deallocate(void* p, std::size_t bytes, std::size_t alignment);
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept {return this == &other;}
+};
+
+// owns every node of one document; the nodes and everything their strings,
+// maps and vectors allocate come out of a single monotonic arena, so the
+// whole tree is released at once when the document goes away.
+// anchors are per document too, so separate documents share no state.
+// map keys, class names and alias names live once in its string pool
+class Document {
+public:
+	typedef std::pmr::unordered_map<std::string_view,Node*> anchor_table;
+private:
+	CountingResource _counter;
+	std::pmr::monotonic_buffer_resource _arena;
+	StringPool _strings;
+	anchor_table _anchors;
+	Node *_root;
+	std::size_t _created[Node::Link + 1];
+	std::size_t _generation;
+public:
+	Document(std::size_t initial_size, std::pmr::memory_resource* upstream);
+	Node& root() {return *_root;}
+	// false until the document has been loaded
+	bool has_root() {return _root != 0;}
+	void set_root(Node* n) {_root = n;}
+	// counts the incremental updates, which replace nodes; a node reached
+	// before one may no longer be part of the document
+	std::size_t generation() {return _generation;}
+	void changed() {++_generation;}
+	std::pmr::memory_resource* resource() {return &_arena;}
+	std::pmr::memory_resource* upstream() {return _counter.upstream();}
+	// the bytes the arena has taken from upstream
+	std::size_t allocated() {return _counter.bytes();}
+	// drops every node, name and anchor at once and gives the arena's
+	// memory back upstream; the counts of nodes created are kept
+	void clear();
+	template<class T, class... Args> T* create(Args&&... args) {
+		T *n = new (_arena.allocate(sizeof(T), alignof(T))) T(&_arena, std::forward<Args>(args)...);
+		++_created[n->get_type()];
+		return n;
+	}
+	// the number of nodes created, by Node::NodeType
+	const std::size_t* created() {return _created;}
+	StringPool& strings() {return _strings;}
+	std::string_view intern(std::string_view s, bool borrow = false) {return _strings.intern(s, borrow);}
+	std::string_view copy(std::string_view s);
+	bool add_anchor(std::string_view alias, Node* n);
+	Node& get_anchor(const std::string& alias);
+	anchor_table& anchors() {return _anchors;}
+private:
+	Document(const Document&);
+	Document& operator=(const Document&);
+};
+
+// a path compiled once from an expression such as servers[3].ports[0] or
+// servers.*!Server.name: .key and a leading key select a map member, [n]
+// a sequence element, * or [*] every member, and !Class keeps only objects
+// of that class. references and links are followed on the way; a step that
+// does not apply to a node reaches nothing. walking does not allocate
+class Path {
+public:
+	struct Step {
+		enum Kind {
+			Key,Index,Every,Class
+		};
+		Kind kind;
+		std::string name; // the key or class
+		Node::size_type index;
 	};
+	Path(std::string_view expression);
+	// the first node reached from root, or 0
+	Node* find(Node& root) const;
+	// calls f with every node reached, in document order, until f returns false
+	template<class F> void each(Node& root, F f) const {walk(&root, 0, f);}
+	const std::vector<Step>& steps() const {return _steps;}
+private:
+	std::vector<Step> _steps;
+	template<class F> bool walk(Node* n, std::size_t i, F& f) const;
+	static bool is_container(Node::NodeType type);
+};
 
-	struct Token {
-		TokenType type;
-		std::string contents;
-		unsigned int line;
+template<class F> bool Path::walk(Node* n, std::size_t i, F& f) const {
+	n = n->resolve();
+	if (!n) {
+		return true;
+	}
+	if (i == _steps.size()) {
+		return f(n);
+	}
+	const Step& s = _steps[i];
+	Node::NodeType type = n->get_type();
+	switch (s.kind) {
+		case Step::Key: {
+			Node *m = type == Node::Map || type == Node::ObjMap ? n->find(s.name) : 0;
+			return m ? walk(m, i + 1, f) : true;
+		}
+		case Step::Index:
+			if ((type == Node::Sequence || type == Node::ObjSequence) && s.index < n->size()) {
+				return walk(&(*n)[s.index], i + 1, f);
+			}
+			return true;
+		case Step::Every:
+			if (is_container(type)) {
+				for (Node::iterator it = n->begin(); it != n->end(); ++it) {
+					if (!walk(*it, i + 1, f)) {
+						return false;
+					}
+				}
+			}
+			return true;
+		case Step::Class:
+		default:
+			return n->class_name() == s.name ? walk(n, i + 1, f) : true;
+	}
+}
+
+// a path bound to one root, which keeps the nodes it reached the first
+// time. bound to a document, it takes the document's root when it is
+// first used, so it may be made before the document is loaded, and reaches
+// the nodes again after an incremental update; bound to a node, it assumes
+// the tree under that node does not change
+class Accessor {
+	Path _path;
+	Document *_document;
+	std::size_t _generation;
+	Node *_root;
+	Node *_first;
+	bool _found, _listed;
+	std::vector<Node*> _nodes;
+	void refresh();
+public:
+	Accessor(const Path& path, Node& root);
+	Accessor(std::string_view expression, Node& root);
+	Accessor(const Path& path, Document& document);
+	Accessor(std::string_view expression, Document& document);
+	// the first node reached, or 0
+	Node* get();
+	// the first node reached; throws if there is none
+	Node& operator*();
+	Node* operator->() {return &**this;}
+	template<class T> void operator>>(T& value) {**this >> value;}
+	// every node reached
+	const std::vector<Node*>& all();
+};
+
+enum TokenType {
+	TOK_CBRACE_L,
+	TOK_CBRACE_R,
+	TOK_SBRACE_L,
+	TOK_SBRACE_R,
+	TOK_RBRACE_L,
+	TOK_RBRACE_R,
+	TOK_BANG,
+	TOK_ASTERISK,
+	TOK_AT,
+	TOK_AMPERSAND,
+	TOK_COLON,
+	TOK_COMMA,
+	TOK_IDENTIFIER,
+	TOK_STRING,
+	TOK_INT,
+	TOK_FLOAT,
+	TOK_BOOL
+};
+
+// contents view the input, except for strings whose escapes or comments
+// had to be taken out; those own their text
+struct Token {
+	TokenType type;
+	std::string_view contents;
+	std::string text;
+	bool owned;
+	unsigned int line;
+	Token(): type(TOK_COMMA), owned(false), line(0) {}
+	Token(const Token& t);
+	Token(Token&& t) noexcept;
+	Token& operator=(const Token& t);
+	Token& operator=(Token&& t) noexcept;
+};
+
+// the lexer's first stage: classifies the input 64 bytes at a time into
+// bit masks, with AVX2 or SSE2 when the processor has them, and answers
+// where a run of one class of bytes ends from those masks. blocks are
+// classified as the lexer reaches them, so each byte is looked at once.
+// without either, runs are found a byte at a time from a table. build
+// with DMON_NO_SIMD or DMON_NO_AVX2 to leave the instructions out
+class StructuralIndex {
+public:
+	struct Block {
+		std::uint64_t space;   // tab, line breaks and blanks
+		std::uint64_t word;    // identifier letters and digits
+		std::uint64_t stop;    // what ends a plain run of a string: '"', '\\' and '#'
+		std::uint64_t newline;
 	};
+	enum Kind {
+		Space,Word,Stop
+	};
+	typedef void (*Classifier)(const char* p, Block& b);
+	StructuralIndex(const char* end): _end(end), _block(0) {}
+	// the first byte from p on that is not whitespace, counting the lines passed
+	const char* skip_space(const char* p, unsigned int& lines) {
+		std::uint64_t offset = (std::uintptr_t)p - (std::uintptr_t)_block;
+		if (offset < 64) {
+			std::uint64_t ends = ~_masks.space >> offset;
+			if (ends) {
+				unsigned int n = first_bit(ends);
+				lines += count_lines(offset, n);
+				return p + n;
+			}
+		}
+		return run(p, Space, &lines);
+	}
+	// the first byte from p on that cannot continue an identifier
+	const char* skip_word(const char* p) {
+		std::uint64_t offset = (std::uintptr_t)p - (std::uintptr_t)_block;
+		if (offset < 64) {
+			std::uint64_t ends = ~_masks.word >> offset;
+			if (ends) {
+				return p + first_bit(ends);
+			}
+		}
+		return run(p, Word, 0);
+	}
+	// the first quote, backslash or '#' from p on, counting the lines passed
+	const char* find_stop(const char* p, unsigned int& lines) {
+		std::uint64_t offset = (std::uintptr_t)p - (std::uintptr_t)_block;
+		if (offset < 64) {
+			std::uint64_t ends = _masks.stop >> offset;
+			if (ends) {
+				unsigned int n = first_bit(ends);
+				lines += count_lines(offset, n);
+				return p + n;
+			}
+		}
+		return run(p, Stop, &lines);
+	}
+	// the classifier picked for this processor: "avx2", "sse2" or "scalar"
+	static const char* level();
+private:
+	const char *_end;
+	const char *_block;
+	Block _masks;
+	static Classifier classifier();
+	const char* run(const char* p, Kind kind, unsigned int* lines);
+	const char* run_bytes(const char* p, Kind kind, unsigned int* lines);
+	void classify(const char* p);
+	unsigned int count_lines(std::uint64_t offset, unsigned int n) {
+		return n ? bit_count((_masks.newline >> offset) & (~(std::uint64_t)0 >> (64 - n))) : 0;
+	}
+#if defined(_MSC_VER) && !defined(__clang__)
+	static unsigned int first_bit(std::uint64_t m) {unsigned long i; _BitScanForward64(&i, m); return (unsigned int)i;}
+	static unsigned int bit_count(std::uint64_t m) {return (unsigned int)__popcnt64(m);}
+#else
+	static unsigned int first_bit(std::uint64_t m) {return (unsigned int)__builtin_ctzll(m);}
+	static unsigned int bit_count(std::uint64_t m) {return (unsigned int)__builtin_popcountll(m);}
+#endif
+};
 
+class Lexer {
+	const char *_cur, *_end;
 	unsigned int _cur_line;
+	bool _skip_comments;
+	StructuralIndex _index;
+public:
+	Lexer(const char* begin, const char* end);
+	bool lex_token(Token& t);
+	unsigned int line() {return _cur_line;}
+	// continues lexing from p, which must lie between tokens
+	void skip_to(const char* p, unsigned int line);
+private:
+	void set_skip_comments(bool mode);
+	void next_sym();
+	void skip_comment();
+	bool is_a_digit(char c);
+	bool is_an_identifier_letter(char c);
+	bool is_a_sign(char c);
+	bool is_whitespace(char c);
+};
+
+// routes parser messages to a caller supplied sink; below the configured
+// level nothing is formatted, so a silent parser pays one branch per site
+class Diagnostics {
+public:
+	enum Level {
+		Silent,Info,Trace
+	};
+	enum Channel {
+		Phases,Tokens,Cycles
+	};
+	struct Record {
+		Level level;
+		Channel channel;
+		const char *phase;
+		double seconds;
+		std::string text;
+	};
+	typedef std::function<void(const Record&)> Sink;
+	Diagnostics(): _level(Diagnostics::Silent) {}
+	void set_sink(Level level, Sink sink);
+	bool enabled(Level level) {return level <= _level;}
+	void message(Level level, Channel channel, const std::string& text);
+	void timing(const char* phase, double seconds);
+	// the seconds spent in each phase so far, in the order they first ran;
+	// kept whether or not a sink is installed
+	const std::vector<std::pair<const char*,double> >& totals() {return _totals;}
+private:
+	Level _level;
+	Sink _sink;
+	std::vector<std::pair<const char*,double> > _totals;
+};
+
+// tag bytes of the binary form; an anchor tag names the value after it
+enum BinaryTag {
+	BIN_STRING = 1,
+	BIN_INT,
+	BIN_FLOAT,
+	BIN_FALSE,
+	BIN_TRUE,
+	BIN_MAP,
+	BIN_SEQUENCE,
+	BIN_OBJMAP,
+	BIN_OBJSEQUENCE,
+	BIN_REFERENCE,
+	BIN_LINK,
+	BIN_ANCHOR
+};
+
+// bounds checked reads over a binary document: a header, a table of every
+// name, then the values, with keys, class names and aliases as table indices
+class BinaryCursor {
+	const char *_cur, *_end;
+public:
+	static const char magic[4];
+	static const unsigned char version = 1;
+	// containers nested deeper than this are refused, as decoding recurses
+	static const unsigned int max_depth = 1024;
+	std::vector<std::string_view> names;
+	BinaryCursor(): _cur(0), _end(0) {}
+	BinaryCursor(const char* begin, const char* end): _cur(begin), _end(end) {}
+	static bool is_binary(const char* begin, const char* end);
+	// checks the header and leaves the name table to the caller
+	void header();
+	bool at_end() {return _cur == _end;}
+	unsigned char byte();
+	unsigned long long varint();
+	// an element count, which cannot exceed the bytes left
+	std::size_t count();
+	long long zigzag();
+	double float64();
+	std::string_view bytes(std::size_t n);
+	std::string_view name();
+};
+
+class Parser {
+	friend class Node;
+	// the members of a container, between its brackets, as found by the
+	// lazy mode's grammar check; spans are kept in the order they open
+	struct Span {
+		const char *begin, *end;
+		unsigned int line, end_line;
+		unsigned int next; // the first span after this container's
+		Node::NodeType type;
+		std::string_view name; // the class of an object
+	};
 	bool _generated;
-	std::istream& _is;
+	InputBuffer _input;
+	Lexer _lexer;
+	Document _document;
 	std::vector<Token> _token_list;
-	std::istream_iterator<char> _iit, _eos;
 	std::vector<Token>::iterator _cur_token;
-	bool _skip_comments;
-	Node *_document;
-	bool **_graph;
-	std::map<std::string,int> _ordering;
-	int *_color;
+	Token _lookahead;
+	Token *_tok;
+	bool _single_pass;
+	bool _keep_key_order;
+	bool _zero_copy;
+	Diagnostics _diag;
+	std::unordered_map<const char*,int> _alias_ids; // keyed by interned name
+	std::vector<std::string_view> _alias_names;
+	std::vector<std::pair<int,int> > _alias_edges;
+	std::vector<char> _color; // of each alias, while checking for cycles
+	std::vector<int> _pending;
+	std::vector<Node*> _references;
+	bool _lazy;
+	std::vector<Span> _spans;
+	std::size_t _next_span;
+	std::unordered_map<const char*,Node*> _presets; // keyed by where the alias is in the input
+	Token _literal;
+	// a parallel load cuts the top level map or sequence at its commas and
+	// builds the members between the cuts as parts, each with a parser of
+	// its own, which point back at the whole
+	static const std::size_t split_size = 1 << 16;
+	static const unsigned int parts_per_thread = 4;
+	unsigned int _threads;
+	bool _split;
+	unsigned int _depth;
+	std::vector<std::pair<const char*,unsigned int> > _cuts; // the top level's brackets and commas, with their lines
+	std::string_view _root_alias;
+	std::vector<std::unique_ptr<Parser> > _parts;
+	Parser *_whole;
+	std::unordered_set<std::string_view> _interned; // the whole's names a part has already seen
+	std::vector<std::pair<std::string_view,Node*> > _anchored;
+	Parser(Parser& whole, const char* begin, const char* end, unsigned int line);
+	// an incremental parser keeps its text, where every container lies in
+	// it, and every alias and reference, all by offset, so that an edit only
+	// rebuilds the containers around it. the edges between aliases, the
+	// definitions and the references naming each alias are kept by alias id,
+	// so that an update takes out and puts back only those of the marks it
+	// replaced
+	struct Extent {
+		std::size_t start, begin, end; // the first token, the members, the closing bracket
+		unsigned int line, end_line; // of begin and end
+		unsigned int next; // the first extent after this container's, as with spans
+		int parent; // the extent this container is a member of, or -1
+		Node::NodeType type;
+		Node *node;
+	};
+	struct Mark {
+		std::size_t begin, end; // the value an alias names, or where a target is named
+		std::string_view name;
+		Node *node; // the aliased value, or the reference or link
+		bool alias;
+		bool first; // the definition the anchor names, which comes first as loading goes
+		int id; // of the name
+		int parent; // the alias this mark is an edge from, or -1
+	};
+	bool _incremental;
+	std::string _text;
+	const char *_base; // the text being interpreted
+	std::vector<Extent> _extents, _fresh; // in the order they open
+	std::vector<Mark> _marks, _fresh_marks; // in the order they end
+	std::vector<unsigned int> _open;
+	std::vector<std::pair<std::size_t,std::size_t> > _kept; // the old extents taken over, start to end
+	std::vector<std::vector<int> > _adjacent; // the edges from each alias
+	std::vector<std::vector<Node*> > _referrers; // the references and links naming each alias
+	std::vector<unsigned int> _definitions; // of each alias
+	std::size_t _live; // the bytes the document took when it was last built whole
+	const char *_value_start;
+	unsigned int _value_line;
+	std::size_t _closed_at;
+	// the edit replaced [_edit_begin, _edit_end) of the old text with
+	// [_edit_begin, _edit_new_end) of the new one; extents from
+	// _region_first to _region_last may be taken over
+	std::size_t _edit_begin, _edit_end, _edit_new_end;
+	long _edit_lines;
+	std::size_t _region_first, _region_last;
 public:
-	Parser(std::istream& is);
+	// what loading the document found and what it cost. the counts take an
+	// increment per token and node and the timings two clock reads per
+	// phase, so they are always kept
+	struct Stats {
+		std::size_t bytes; // of input
+		std::size_t tokens[TOK_BOOL + 1]; // lexed, by TokenType
+		std::size_t nodes[Node::Link + 1]; // built, by Node::NodeType
+		std::size_t aliases; // names defined
+		std::size_t references, links;
+		unsigned int depth; // the deepest nesting of containers
+		std::size_t allocated; // the bytes the document took from its upstream resource
+		std::vector<std::pair<const char*,double> > seconds; // by phase, as in Diagnostics::totals
+		// calls f with a name and value for each of the above, with names
+		// such as bytes, tokens.STRING, nodes.Map or seconds.lex
+		void report(const std::function<void(const std::string&,double)>& f) const;
+	};
+	Parser(std::istream& is, std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+	Parser(const char* begin, const char* end, std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+	Parser(const std::string& filename, InputBuffer::Mode mode, std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+	// binary input is recognized by its header and decoded instead of parsed
 	Node& get_document();
+	// the document behind get_document(), with its anchors
+	Document& document() {return _document;}
+	// the names used by the document; keys found here can be looked up with find_interned
+	StringPool& strings() {return _document.strings();}
 	void print_tokens();
+	// lex on demand and build nodes while validating, without keeping the tokens
+	void set_single_pass(bool mode);
+	// iterate maps in source order rather than sorted by key
+	void set_keep_key_order(bool mode);
+	// names and strings without escapes point into the input instead of
+	// being copied; a borrowed input must then outlive the parser
+	void set_zero_copy(bool mode);
+	// only check the grammar and aliases when loading, and build the members
+	// of a container when it is first reached; the parser and its input must
+	// outlive the document, and a document is not to be read from several
+	// threads at once. errors found while building, such as duplicate keys,
+	// are thrown from the access that reached them
+	void set_lazy(bool mode);
+	// build the members of a large top level map or sequence on up to n
+	// threads, 0 for one per core; the upstream resource must then be safe
+	// to allocate from concurrently. lazy loading takes precedence
+	void set_threads(unsigned int n);
+	// keep what is needed to update the document after its text is edited;
+	// strings are then always copied. takes precedence over lazy loading
+	// and threads
+	void set_incremental(bool mode);
+	// replaces the text with an edited one and updates the document in
+	// place: only the innermost map or sequence holding the whole edit is
+	// built again, taking over the containers the edit left alone, and only
+	// the aliases the edit defined, named or nested are checked and resolved
+	// again. that map or sequence keeps its address, but the members built
+	// again are new nodes, and the root is new when the whole text was built
+	// again; the document's generation tells a holder of nodes to look them
+	// up again. once the arena has taken as many bytes again since the
+	// document was last built whole as that build did, the document is
+	// built whole into a fresh arena, which releases the replaced nodes. on
+	// an error the document and text are left as they were
+	Node& update(const char* begin, const char* end);
+	// the same, for an edit that replaces length bytes at offset of the
+	// current text; the text is not compared to find the edit
+	Node& update(std::size_t offset, std::size_t length, std::string_view replacement);
+	// parsing is silent unless a sink is installed
+	void set_diagnostics(Diagnostics::Level level, Diagnostics::Sink sink);
+	// as of the last load or update. a lazy document counts the nodes built
+	// so far, and an incremental one the tokens of every update, and the
+	// depth reached by any
+	const Stats& stats();
 private:
+	Stats _stats;
+	bool _count_tokens; // off once a lazy load has been through the whole input
+	void descend() {if (++_depth > _stats.depth) _stats.depth = _depth;}
 	void lex();
+	void first_token();
+	void next_token();
+	unsigned int token_line();
+	void count_token(Token& t);
 	void parse();
 	void interpret();
-	void set_skip_comments(bool mode);
-	void next_sym();
-	bool is_a_digit(char c);
-	bool is_an_identifier_letter(char c);
-	bool is_a_sign(char c);
-	bool is_whitespace(char c);
+	void link_aliases();
+	void decode();
+	Node* decode_value(BinaryCursor& in);
 	bool expect(TokenType t);
 	bool accept(TokenType t);
+	std::string_view expect_identifier();
+	std::string_view intern(std::string_view name);
+	StringPool* pool();
 	void parse_value();
 	void parse_pair();
-	void parse_map();
-	void parse_seq();
-	void parse_obj();
+	void parse_map(std::size_t span);
+	void parse_seq(std::size_t span);
+	void parse_obj(std::size_t span);
+	void open_span(Node::NodeType type);
+	void close_span(std::size_t span, TokenType t);
+	TokenType closing(Node::NodeType type);
+	bool separator();
+	void cut(unsigned int depth);
+	bool splittable();
+	void interpret_parts();
+	void interpret_part(bool pairs);
+	void edit(std::size_t offset, std::size_t length, std::string_view replacement);
+	void compact();
+	std::size_t enclosing();
+	bool rebuild(std::size_t e, Node*& built);
+	void commit(std::size_t e, Node* built);
+	int outer_alias(std::size_t e);
+	void gather(std::vector<Mark>& marks, int outer);
+	bool confined(std::size_t first, std::size_t last, const std::vector<Mark>& marks);
+	void remove_edge(int from, int to);
+	std::size_t moved(std::size_t at);
+	unsigned int moved_line(unsigned int line, std::size_t at);
+	void open_extent(const char* bracket, unsigned int line);
+	void close_extent(TokenType t, Node* n);
+	Node* reused();
+	long long to_int(Token& t);
+	double to_float(Token& t);
 	Node* interpret_value();
+	Node* interpret_literal(Token& t);
 	Node* interpret_map();
+	void interpret_pairs(Node* map);
+	void interpret_elements(Node* seq);
+	void seal_map(Node* map);
 	Node* interpret_seq();
 	Node* interpret_obj();
 	Node* interpret_ref();
 	Node* interpret_link();
-	void check_for_cycles();
-	void recursive_check(Node* n, std::string alias);
-	void dfs_visit(int i);
+	void interpret_target(Node* ref);
+	Node* deferred(std::size_t span);
+	Node* skip_container();
+	void expand(Node* n, unsigned int span);
+	int alias_id(std::string_view alias);
+	void add_alias_edges(int from, std::size_t mark);
+	void check_for_cycles(const std::vector<int>* roots = 0);
+	void report_cycle(std::vector<std::pair<int,std::size_t> >& stack, int target);
+	void resolve_references();
+	void check_for_unknown_aliases();
+};
+
+// pulls one event at a time straight off the lexer, without building nodes;
+// an Alias event names the value that follows it, or the value whose Scalar,
+// Reference, Link or End event it directly follows
+class Reader {
+public:
+	struct Event {
+		enum Kind {
+			BeginMap,BeginSeq,BeginObject,Key,Scalar,Alias,Reference,Link,End
+		};
+		Kind kind;
+		Node::NodeType type;
+		std::string text;
+		unsigned int line;
+	};
+	Reader(std::istream& is);
+	Reader(const char* begin, const char* end);
+	Reader(const std::string& filename, InputBuffer::Mode mode);
+	bool next(Event& e);
+	void skip();
+	unsigned int depth() {return _stack.size();}
+private:
+	enum Step {
+		ValueStart,ValueBody,ValueDone,AfterValue,ContainerOpen,Done
+	};
+	struct Frame {
+		Node::NodeType type;
+		bool has_alias;
+		std::size_t remaining; // members left in a binary container
+	};
+	InputBuffer _input;
+	Lexer _lexer;
+	Token _lookahead;
+	Token *_tok;
+	Step _step;
+	std::vector<Frame> _stack;
+	bool _has_alias;
+	bool _is_ref;
+	bool _binary;
+	BinaryCursor _bin;
+	void start();
+	bool next_binary(Event& e);
+	bool begin_binary_value(Event& e);
+	void next_token();
+	unsigned int token_line();
+	bool expect(TokenType t);
+	bool accept(TokenType t);
+	void take_identifier(std::string& name);
+	bool begin_value(Event& e);
+	TokenType closing(Node::NodeType type);
+	bool is_keyed(Node::NodeType type);
+};
+
+// a member of a bound struct and the key it is read from
+template<class T, class M> struct Field {
+	std::string_view name;
+	M T::*member;
+};
+
+template<class T, class M> constexpr Field<T, M> field(std::string_view name, M T::*member) {
+	return Field<T, M>{name, member};
+}
+
+// the class name and fields of a struct, built at compile time. keys are
+// hashed into buckets of two on average, and each bucket, largest first, is
+// given the displacement that moves all its keys into free slots, so a
+// lookup is one hash, two table reads and one comparison. the table starts
+// at the power of two at or above twice the fields, and is doubled once when
+// no seed lets every bucket be placed
+template<class T, class... M> class BoundClass {
+public:
+	static constexpr std::size_t count = sizeof...(M);
+	static_assert(count > 0 && count < 255, "a bound class needs between 1 and 254 fields");
+	static constexpr std::size_t first_slots = [] {
+		std::size_t n = 2;
+		while (n < count * 2) {
+			n *= 2;
+		}
+		return n;
+	}();
+	static constexpr std::size_t slots = first_slots * 2;
+	static constexpr std::size_t buckets = first_slots < 4 ? 1 : first_slots / 4;
+	static_assert(slots <= count * 8 && buckets <= count, "the tables of a bound class grow linearly with its fields");
+	static constexpr std::uint32_t seeds = 16; // tried at each size
+	static constexpr std::uint32_t displacements = 4096; // tried for each bucket
+	std::string_view name;
+	std::tuple<Field<T, M>...> fields;
+	std::string_view keys[count];
+	std::uint32_t seed;
+	std::uint32_t mask;
+	std::uint16_t displacement[buckets];
+	unsigned char table[slots]; // field index + 1, or 0
+	constexpr BoundClass(std::string_view class_name, Field<T, M>... f):
+		name(class_name), fields(f...), keys{f.name...}, seed(0), mask(first_slots - 1), displacement{}, table{}
+	{
+		for (std::size_t i = 0; i < count; ++i) {
+			for (std::size_t j = 0; j < i; ++j) {
+				if (keys[i] == keys[j]) {
+					throw std::logic_error("duplicate key in a bound class");
+				}
+			}
+		}
+		for (;; mask = mask * 2 + 1) {
+			for (seed = 0; seed < seeds; ++seed) {
+				if (place()) {
+					return;
+				}
+			}
+			if (mask == slots - 1) {
+				throw std::logic_error("no seed separates the keys of a bound class");
+			}
+		}
+	}
+	// the index of the field read from key, or -1
+	constexpr int find(std::string_view key) const {
+		std::uint32_t h = hash(seed, key);
+		unsigned char slot = table[spread(h, displacement[bucket(h)]) & mask];
+		return slot && keys[slot - 1] == key ? slot - 1 : -1;
+	}
+	// fnv-1a, which only carries each byte upward, then the murmur3
+	// finalizer, so that the bits the tables use depend on every bit
+	static constexpr std::uint32_t hash(std::uint32_t seed, std::string_view key) {
+		std::uint32_t h = 2166136261u ^ (seed * 16777619u);
+		for (std::size_t i = 0; i < key.size(); ++i) {
+			h = (h ^ (unsigned char)key[i]) * 16777619u;
+		}
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35u;
+		h ^= h >> 16;
+		return h;
+	}
+private:
+	// the bucket takes the high bits of the hash and the slot the low bits
+	// of it mixed with the displacement
+	static constexpr std::size_t bucket(std::uint32_t h) {
+		return (h >> 16) & (buckets - 1);
+	}
+	static constexpr std::uint32_t spread(std::uint32_t h, std::uint32_t d) {
+		h += d * 0x9e3779b9u;
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		return h;
+	}
+	// places every bucket under the current seed and mask, or leaves the
+	// table empty and returns false when one cannot be
+	constexpr bool place() {
+		std::uint32_t h[count] = {};
+		std::size_t size[buckets] = {};
+		std::size_t largest = 0;
+		for (std::size_t i = 0; i < count; ++i) {
+			h[i] = hash(seed, keys[i]);
+			std::size_t n = ++size[bucket(h[i])];
+			largest = n > largest ? n : largest;
+		}
+		for (std::size_t n = largest; n > 0; --n) {
+			for (std::size_t b = 0; b < buckets; ++b) {
+				if (size[b] == n && !displace(h, b)) {
+					for (std::size_t i = 0; i <= mask; ++i) {
+						table[i] = 0;
+					}
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+	// finds the first displacement that puts the keys of bucket b in free
+	// slots, and takes them
+	constexpr bool displace(const std::uint32_t* h, std::size_t b) {
+		for (std::uint32_t d = 0; d < displacements; ++d) {
+			std::size_t i = 0;
+			for (; i < count; ++i) {
+				if (bucket(h[i]) != b) {
+					continue;
+				}
+				unsigned char& slot = table[spread(h[i], d) & mask];
+				if (slot) {
+					break;
+				}
+				slot = (unsigned char)(i + 1);
+			}
+			if (i == count) {
+				displacement[b] = (std::uint16_t)d;
+				return true;
+			}
+			for (std::size_t j = 0; j < i; ++j) {
+				if (bucket(h[j]) == b) {
+					table[spread(h[j], d) & mask] = 0;
+				}
+			}
+		}
+		return false;
+	}
+};
+
+template<class T, class... M> constexpr BoundClass<T, M...> bind_class(std::string_view name, Field<T, M>... f) {
+	return BoundClass<T, M...>(name, f...);
+}
+
+// specialised for each bound struct with a static constexpr member named
+// fields, for example
+//   template<> struct Binding<Server> {
+//       static constexpr auto fields = bind_class("Server", field("host", &Server::host), field("port", &Server::port));
+//   };
+template<class T> struct Binding;
+
+// decodes objects from a Reader straight into bound structs, without
+// building nodes. a map object sets the fields named by its keys and skips
+// the others; a sequence object sets the fields in the order they are
+// bound. members are int, long long, double, bool, std::string, vectors of
+// them, or other bound structs; aliases are ignored, while references and
+// links cannot be bound as there is no tree to resolve them against
+class Binder {
+public:
+	Binder(Reader& reader): _reader(reader) {}
+	// reads the next value
+	template<class T> void read(T& value) {
+		next();
+		read_value(value);
+	}
+	// calls f with every object of T's class in the rest of the document, in
+	// the order they start; one that is read is not searched any further
+	template<class T, class F> void each(F f);
+private:
+	Reader& _reader;
+	Reader::Event _event;
+	void next();
+	void skip();
+	void expect(Reader::Event::Kind kind, const char* what);
+	void read_value(int& n);
+	void read_value(long long& n);
+	void read_value(double& x);
+	void read_value(bool& b);
+	void read_value(std::string& s);
+	template<class V> void read_value(std::vector<V>& v);
+	template<class T> void read_value(T& value);
+	template<class T, std::size_t I> static void read_field(Binder& binder, T& value) {
+		binder.read_value(value.*std::get<I>(Binding<T>::fields.fields).member);
+	}
+	template<class T, std::size_t... I> void read_field(T& value, std::size_t i, std::index_sequence<I...>) {
+		static void (*const readers[])(Binder&, T&) = {&Binder::read_field<T, I>...};
+		readers[i](*this, value);
+	}
+};
+
+template<class V> void Binder::read_value(std::vector<V>& v) {
+	expect(Reader::Event::BeginSeq, "a sequence");
+	v.clear();
+	for (next(); _event.kind != Reader::Event::End; next()) {
+		v.emplace_back();
+		read_value(v.back());
+	}
+}
+
+template<class T> void Binder::read_value(T& value) {
+	const auto& bound = Binding<T>::fields;
+	typedef std::make_index_sequence<std::remove_reference_t<decltype(bound)>::count> indices;
+	expect(Reader::Event::BeginObject, "an object");
+	if (_event.text != bound.name) {
+		throw BindException(_event.line, std::string("expected !") + std::string(bound.name) + ", found !" + _event.text);
+	}
+	if (_event.type == Node::ObjMap) {
+		for (next(); _event.kind == Reader::Event::Key; next()) {
+			int i = bound.find(_event.text);
+			next();
+			if (i < 0) {
+				skip();
+			} else {
+				read_field(value, i, indices());
+			}
+		}
+	} else {
+		std::size_t i = 0;
+		for (next(); _event.kind != Reader::Event::End; next(), ++i) {
+			if (i == bound.count) {
+				throw BindException(_event.line, std::string("too many members for !") + std::string(bound.name));
+			}
+			read_field(value, i, indices());
+		}
+	}
+}
+
+template<class T, class F> void Binder::each(F f) {
+	const auto& bound = Binding<T>::fields;
+	while (_reader.next(_event)) {
+		if (_event.kind == Reader::Event::BeginObject && _event.text == bound.name) {
+			T value{};
+			read_value(value);
+			f(value);
+		}
+	}
+}
+
+// writes dmon text through a fixed buffer, either from a tree or from a
+// sequence of calls mirroring the grammar; an anchor names the value after it
+class Emitter {
+public:
+	enum Style {
+		Compact,Pretty
+	};
+	Emitter(int fd, Style style = Emitter::Compact);
+	Emitter(std::string& out, Style style = Emitter::Compact);
+	~Emitter();
+	void begin_map();
+	void begin_seq();
+	void begin_object(std::string_view class_name);
+	void end();
+	void key(std::string_view name);
+	void anchor(std::string_view name);
+	void value(std::string_view s);
+	void value(const char* s) {value(std::string_view(s));}
+	void value(int n) {value((long long)n);}
+	void value(long long n);
+	void value(double x);
+	void value(bool b);
+	void reference(std::string_view alias);
+	void link(std::string_view alias);
+	// a subtree without anchors, or a whole document with them
+	void write(Node& n);
+	void write(Document& doc);
+	void flush();
+private:
+	static const std::size_t buffer_size = 1 << 16;
+	struct Frame {
+		char closing;
+		std::size_t count;
+	};
+	int _fd;
+	std::string *_out;
+	Style _style;
+	std::vector<Frame> _stack;
+	bool _attached; // a key or anchor is waiting for its value
+	std::unordered_map<const Node*,std::string_view> _anchor_names;
+	std::string _text;
+	char *_pos;
+	char _buffer[buffer_size];
+	void put(char c) {
+		if (_pos == _buffer + buffer_size) flush();
+		*_pos++ = c;
+	}
+	void put(const char* s, std::size_t n) {
+		if (n <= (std::size_t)(_buffer + buffer_size - _pos)) {
+			std::memcpy(_pos, s, n);
+			_pos += n;
+		} else {
+			put_chunked(s, n);
+		}
+	}
+	void put_chunked(const char* s, std::size_t n);
+	void item();
+	void open(char opening, char closing);
+	void identifier(std::string_view name);
+	void write_node(Node& n);
+	Emitter(const Emitter&);
+	Emitter& operator=(const Emitter&);
+};
+
+// writes the binary form of a tree; every name is gathered into the table
+// first, so the values that follow refer to names by index only
+class Encoder {
+public:
+	Encoder(std::string& out);
+	void write(Node& n);
+	void write(Document& doc);
+private:
+	std::string& _out;
+	std::unordered_map<std::string_view,unsigned int> _name_ids;
+	std::vector<std::string_view> _names;
+	std::unordered_set<std::string> _class_names;
+	std::unordered_map<const Node*,std::string_view> _anchor_names;
+	std::string _text;
+	void collect(Node& n);
+	void add_name(std::string_view name);
+	void name(std::string_view name);
+	void write_node(Node& n);
+	void varint(unsigned long long v);
+	void bytes(std::string_view s);
+	Encoder(const Encoder&);
+	Encoder& operator=(const Encoder&);
+};
+
+// a document laid out to be read in place; records refer to each other, to
+// names and to strings by their offset from the start of the image, so a
+// mapped file or shared memory segment is used as it is. values are in the
+// byte order of the machine that wrote them
+struct ImageHeader {
+	char magic[4];
+	std::uint32_t version;
+	std::uint32_t byte_order;
+	std::uint32_t size;
+	std::uint32_t root;
+	std::uint32_t anchors; // name and record pairs, sorted by name
+	std::uint32_t anchor_count;
+	std::uint32_t reserved;
+};
+
+// strings are a length followed by their bytes. a map's data holds key and
+// record pairs, then a hash index of entry positions once it is larger than
+// Image::small_map_size; a sequence's data holds records. a reference or
+// link holds the record it resolves to
+struct ImageRecord {
+	std::uint32_t type;
+	std::uint32_t name; // contents, class name or target
+	union {
+		struct {
+			std::uint32_t count, data;
+		} items;
+		long long integer;
+		double real;
+	} value;
+};
+
+class ImageNode;
+
+// a mapped image, a copy of one, or a caller's buffer that must outlive it;
+// the header is checked on opening and every offset when it is followed
+class Image {
+public:
+	static const char magic[4];
+	static const std::uint32_t version = 1;
+	static const std::uint32_t byte_order = 0x01020304;
+	static const std::size_t small_map_size = 8;
+	Image(const std::string& filename, InputBuffer::Mode mode = InputBuffer::Mapped);
+	Image(const char* begin, const char* end);
+	static bool is_image(const char* begin, const char* end);
+	// slots in the hash index of a map with count entries, 0 when it is scanned
+	static std::size_t index_size(std::size_t count);
+	static std::uint32_t hash(std::string_view key);
+	ImageNode root();
+	ImageNode get_anchor(std::string_view alias);
+	std::size_t size() const {return _size;}
+	const ImageRecord* record(std::uint32_t offset) const;
+	const std::uint32_t* words(std::uint32_t offset, std::size_t n) const;
+	std::string_view string(std::uint32_t offset) const;
+private:
+	InputBuffer _input;
+	const char *_base;
+	std::size_t _size;
+	void open();
+	Image(const Image&);
+	Image& operator=(const Image&);
+};
+
+// a node of an image with the reading surface of Node; it is a pair of
+// pointers and is passed by value. references and links read through to
+// the node they resolve to, and find() returns an empty node for a
+// missing key
+class ImageNode {
+public:
+	typedef Node::size_type size_type;
+	class iterator;
+	ImageNode(): _image(0), _record(0) {}
+	ImageNode(const Image* image, const ImageRecord* record): _image(image), _record(record) {}
+	explicit operator bool() const {return _record != 0;}
+	Node::NodeType get_type() const {return (Node::NodeType)_record->type;}
+	ImageNode operator[](size_type n) const;
+	ImageNode operator[](std::string_view key) const;
+	ImageNode find(std::string_view key) const;
+	size_type size() const;
+	std::string get_class_name() const;
+	void operator>>(int &n) const;
+	void operator>>(long long &n) const;
+	void operator>>(double &x) const;
+	void operator>>(std::string &s) const;
+	void operator>>(bool &b) const;
+	// a view of the string in the image, without copying it out
+	std::string_view view() const;
+	iterator begin() const;
+	iterator end() const;
+	ImageNode resolve() const;
+	std::string_view get_target() const;
+private:
+	const Image *_image;
+	const ImageRecord *_record;
+	const ImageRecord* target() const;
+	bool is_map(const ImageRecord* r) const;
+	const std::uint32_t* items(const ImageRecord* r) const;
+};
+
+// walks the data of a map, two words per entry, or of a sequence, one word
+class ImageNode::iterator {
+	const Image *_image;
+	const std::uint32_t *_at;
+	int _stride;
+public:
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef ImageNode value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef const ImageNode* pointer;
+	typedef ImageNode reference;
+	iterator(): _image(0), _at(0), _stride(1) {}
+	iterator(const Image* image, const std::uint32_t* at, int stride): _image(image), _at(at), _stride(stride) {}
+	ImageNode operator*() const {return ImageNode(_image, _image->record(_at[_stride - 1]));}
+	ImageNode operator[](difference_type n) const {return *(*this + n);}
+	// the key of a map entry, empty for sequence elements
+	std::string_view key() const {return _stride == 2 ? _image->string(_at[0]) : std::string_view();}
+	iterator& operator+=(difference_type n) {_at += n * _stride; return *this;}
+	iterator& operator-=(difference_type n) {return *this += -n;}
+	iterator& operator++() {return *this += 1;}
+	iterator& operator--() {return *this += -1;}
+	iterator operator++(int) {iterator tmp(*this); *this += 1; return tmp;}
+	iterator operator--(int) {iterator tmp(*this); *this += -1; return tmp;}
+	iterator operator+(difference_type n) const {iterator tmp(*this); return tmp += n;}
+	iterator operator-(difference_type n) const {iterator tmp(*this); return tmp += -n;}
+	friend iterator operator+(difference_type n, const iterator& it) {return it + n;}
+	difference_type operator-(const iterator& rhs) const {return (_at - rhs._at) / _stride;}
+	bool operator==(const iterator& rhs) const {return _at == rhs._at;}
+	bool operator!=(const iterator& rhs) const {return _at != rhs._at;}
+	bool operator<(const iterator& rhs) const {return _at < rhs._at;}
+	bool operator>(const iterator& rhs) const {return rhs < *this;}
+	bool operator<=(const iterator& rhs) const {return !(rhs < *this);}
+	bool operator>=(const iterator& rhs) const {return !(*this < rhs);}
+};
+
+// lays a tree out as an image; references are written as the offset of the
+// record they resolve to, so their targets must be part of the tree
+class ImageWriter {
+public:
+	ImageWriter(std::string& out);
+	void write(Node& n);
+	void write(Document& doc);
+private:
+	std::string& _out;
+	std::size_t _start;
+	std::unordered_map<std::string_view,std::uint32_t> _names;
+	std::unordered_set<std::string> _class_names;
+	std::unordered_map<const Node*,std::uint32_t> _targets;
+	std::vector<std::pair<std::uint32_t,const Node*> > _references;
+	std::vector<std::pair<std::string_view,const Node*> > _anchors;
+	std::string _text;
+	void collect(Node& n);
+	std::uint32_t reserve(std::size_t n, std::size_t align);
+	std::uint32_t name(std::string_view s);
+	std::uint32_t string(std::string_view s);
+	std::uint32_t write_node(Node& n);
+	void put(std::uint32_t at, const void* p, std::size_t n);
+	ImageWriter(const ImageWriter&);
+	ImageWriter& operator=(const ImageWriter&);
 };
 
-std::string tokentypes[];
-std::string types[];
+extern std::string tokentypes[];
+extern std::string types[];
 
 #endif
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "parser.h"
+#include <string>
+#include <vector>
+#include <string_view>
+
+static bool is_name_char(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static void path_error(std::string_view expression, std::size_t at, const char* what) {
+	throw PathException(std::string(what) + " at " + std::to_string(at) + " in " + std::string(expression));
+}
+
+static std::size_t read_name(std::string_view expression, std::size_t at) {
+	std::size_t end = at;
+	while (end < expression.size() && is_name_char(expression[end])) {
+		++end;
+	}
+	if (end == at) {
+		path_error(expression, at, "expected a name");
+	}
+	return end;
+}
+
+Path::Path(std::string_view expression) {
+	std::size_t i = 0;
+	while (i < expression.size()) {
+		Step s;
+		s.index = 0;
+		char c = expression[i];
+		if (c == '!') {
+			std::size_t end = read_name(expression, i + 1);
+			s.kind = Step::Class;
+			s.name = std::string(expression.substr(i + 1, end - i - 1));
+			i = end;
+		} else if (c == '[') {
+			std::size_t end = i + 1;
+			if (end < expression.size() && expression[end] == '*') {
+				s.kind = Step::Every;
+				++end;
+			} else {
+				s.kind = Step::Index;
+				unsigned long long n = 0;
+				for (; end < expression.size() && expression[end] >= '0' && expression[end] <= '9'; ++end) {
+					n = n * 10 + (expression[end] - '0');
+					if (n > (Node::size_type)-1) {
+						path_error(expression, i, "index out of range");
+					}
+				}
+				if (end == i + 1) {
+					path_error(expression, end, "expected an index");
+				}
+				s.index = (Node::size_type)n;
+			}
+			if (end >= expression.size() || expression[end] != ']') {
+				path_error(expression, end, "expected ]");
+			}
+			i = end + 1;
+		} else {
+			if (c == '.') {
+				++i;
+			} else if (!_steps.empty()) {
+				path_error(expression, i, "unexpected character");
+			}
+			if (i < expression.size() && expression[i] == '*') {
+				s.kind = Step::Every;
+				++i;
+			} else {
+				std::size_t end = read_name(expression, i);
+				s.kind = Step::Key;
+				s.name = std::string(expression.substr(i, end - i));
+				i = end;
+			}
+		}
+		_steps.push_back(s);
+	}
+}
+
+Node* Path::find(Node& root) const {
+	Node *found = 0;
+	each(root, [&found](Node* n) {
+		found = n;
+		return false;
+	});
+	return found;
+}
+
+bool Path::is_container(Node::NodeType type) {
+	return type == Node::Map || type == Node::Sequence || type == Node::ObjMap || type == Node::ObjSequence;
+}
+
+Accessor::Accessor(const Path& path, Node& root):
+	_path(path), _document(0), _generation(0), _root(&root), _first(0), _found(false), _listed(false) {}
+
+Accessor::Accessor(std::string_view expression, Node& root):
+	_path(expression), _document(0), _generation(0), _root(&root), _first(0), _found(false), _listed(false) {}
+
+Accessor::Accessor(const Path& path, Document& document):
+	_path(path), _document(&document), _generation(document.generation()), _root(0),
+	_first(0), _found(false), _listed(false) {}
+
+Accessor::Accessor(std::string_view expression, Document& document):
+	_path(expression), _document(&document), _generation(document.generation()), _root(0),
+	_first(0), _found(false), _listed(false) {}
+
+// forgets the nodes reached once the document has been updated, and takes
+// the root of the document only when it is first needed, as it may not have
+// been loaded when the accessor was made
+void Accessor::refresh() {
+	if (!_document) {
+		return;
+	}
+	if (_document->generation() != _generation) {
+		_generation = _document->generation();
+		_root = 0;
+		_found = _listed = false;
+		_nodes.clear();
+	}
+	if (!_root) {
+		if (!_document->has_root()) {
+			throw PathException(std::string("the document has no root"));
+		}
+		_root = &_document->root();
+	}
+}
+
+Node* Accessor::get() {
+	refresh();
+	if (!_found) {
+		_first = _listed ? (_nodes.empty() ? 0 : _nodes.front()) : _path.find(*_root);
+		_found = true;
+	}
+	return _first;
+}
+
+Node& Accessor::operator*() {
+	Node *n = get();
+	if (!n) {
+		throw NodeException(std::string("invalid access"));
+	}
+	return *n;
+}
+
+const std::vector<Node*>& Accessor::all() {
+	refresh();
+	if (!_listed) {
+		std::vector<Node*>& nodes = _nodes;
+		_path.each(*_root, [&nodes](Node* n) {
+			nodes.push_back(n);
+			return true;
+		});
+		_listed = true;
+	}
+	return _nodes;
+}
@@ -0,0 +1,370 @@
+#include "parser.h"
+#include <string>
+#include <vector>
+#include <charconv>
+
+Reader::Reader(std::istream& is):
+	_input(is), _lexer(_input.begin(), _input.end()), _tok(0),
+	_step(Reader::ValueStart), _has_alias(false), _is_ref(false), _binary(false)
+{
+	start();
+}
+
+Reader::Reader(const char* begin, const char* end):
+	_input(begin, end), _lexer(_input.begin(), _input.end()), _tok(0),
+	_step(Reader::ValueStart), _has_alias(false), _is_ref(false), _binary(false)
+{
+	start();
+}
+
+Reader::Reader(const std::string& filename, InputBuffer::Mode mode):
+	_input(filename, mode), _lexer(_input.begin(), _input.end()), _tok(0),
+	_step(Reader::ValueStart), _has_alias(false), _is_ref(false), _binary(false)
+{
+	start();
+}
+
+void Reader::start() {
+	if (BinaryCursor::is_binary(_input.begin(), _input.end())) {
+		_binary = true;
+		_bin = BinaryCursor(_input.begin(), _input.end());
+		_bin.header();
+		std::size_t count = _bin.count();
+		_bin.names.reserve(count);
+		for (std::size_t i = 0; i < count; ++i) {
+			_bin.names.push_back(_bin.bytes(_bin.count()));
+		}
+	} else {
+		next_token();
+	}
+}
+
+// the steps follow Parser::parse_value, parse_pair, parse_map, parse_seq
+// and parse_obj, with the recursion kept on _stack
+bool Reader::next(Event& e) {
+	if (_binary) {
+		return next_binary(e);
+	}
+	for (;;) {
+		switch (_step) {
+			case ValueStart:
+				_has_alias = false;
+				_is_ref = false;
+				_step = ValueBody;
+				if (_tok && _tok->type == TOK_AMPERSAND) {
+					next_token();
+					e.kind = Event::Alias;
+					e.line = token_line();
+					take_identifier(e.text);
+					_has_alias = true;
+					return true;
+				}
+				break;
+			case ValueBody:
+				return begin_value(e);
+			case ValueDone:
+				_step = AfterValue;
+				if (!_has_alias && _tok && _tok->type == TOK_AMPERSAND) {
+					if (_is_ref) {
+						throw ParseException(token_line(), std::string("reference or link is aliased"));
+					}
+					next_token();
+					e.kind = Event::Alias;
+					e.line = token_line();
+					take_identifier(e.text);
+					return true;
+				}
+				break;
+			case AfterValue:
+				if (_stack.empty()) {
+					_step = Done;
+				} else if (accept(TOK_COMMA)) {
+					_step = ValueStart;
+					if (is_keyed(_stack.back().type)) {
+						e.kind = Event::Key;
+						e.line = token_line();
+						take_identifier(e.text);
+						expect(TOK_COLON);
+						return true;
+					}
+				} else {
+					expect(closing(_stack.back().type));
+					e.kind = Event::End;
+					e.type = _stack.back().type;
+					e.text.clear();
+					e.line = token_line();
+					_has_alias = _stack.back().has_alias;
+					_is_ref = false;
+					_stack.pop_back();
+					_step = ValueDone;
+					return true;
+				}
+				break;
+			case ContainerOpen:
+				if (accept(closing(_stack.back().type))) {
+					e.kind = Event::End;
+					e.type = _stack.back().type;
+					e.text.clear();
+					e.line = token_line();
+					_has_alias = _stack.back().has_alias;
+					_is_ref = false;
+					_stack.pop_back();
+					_step = ValueDone;
+					return true;
+				}
+				_step = ValueStart;
+				if (is_keyed(_stack.back().type)) {
+					e.kind = Event::Key;
+					e.line = token_line();
+					take_identifier(e.text);
+					expect(TOK_COLON);
+					return true;
+				}
+				break;
+			case Done:
+			default:
+				return false;
+		}
+	}
+}
+
+// drops the rest of the innermost open container, its End included, by
+// matching brackets on the token stream; the skipped part is not validated
+void Reader::skip() {
+	if (_stack.empty()) {
+		_step = Done;
+		return;
+	}
+	if (_binary) {
+		std::size_t depth = _stack.size();
+		Event e;
+		while (_stack.size() >= depth && next_binary(e)) {
+		}
+		return;
+	}
+	int depth = 0;
+	while (_tok) {
+		TokenType t = _tok->type;
+		next_token();
+		if (t == TOK_CBRACE_L || t == TOK_SBRACE_L || t == TOK_RBRACE_L) {
+			++depth;
+		} else if (t == TOK_CBRACE_R || t == TOK_SBRACE_R || t == TOK_RBRACE_R) {
+			if (depth-- == 0) {
+				_has_alias = _stack.back().has_alias;
+				_is_ref = false;
+				_stack.pop_back();
+				_step = ValueDone;
+				return;
+			}
+		}
+	}
+	throw ParseException(token_line(), std::string("unterminated container"));
+}
+
+bool Reader::begin_value(Event& e) {
+	e.line = token_line();
+	if (accept(TOK_CBRACE_L)) {
+		e.kind = Event::BeginMap;
+		e.type = Node::Map;
+		e.text.clear();
+	} else if (accept(TOK_SBRACE_L)) {
+		e.kind = Event::BeginSeq;
+		e.type = Node::Sequence;
+		e.text.clear();
+	} else if (accept(TOK_BANG)) {
+		take_identifier(e.text);
+		expect(TOK_RBRACE_L);
+		e.kind = Event::BeginObject;
+		e.type = (_tok && (_tok->type == TOK_IDENTIFIER || _tok->type == TOK_RBRACE_R)) ?
+			Node::ObjMap : Node::ObjSequence;
+	} else if (_tok && (_tok->type == TOK_ASTERISK || _tok->type == TOK_AT)) {
+		bool link = _tok->type == TOK_AT;
+		next_token();
+		if (_has_alias) {
+			throw ParseException(token_line(), std::string("reference or link is aliased"));
+		}
+		e.kind = link ? Event::Link : Event::Reference;
+		e.type = link ? Node::Link : Node::Reference;
+		take_identifier(e.text);
+		_is_ref = true;
+		_step = ValueDone;
+		return true;
+	} else if (_tok && (_tok->type == TOK_STRING || _tok->type == TOK_INT ||
+		_tok->type == TOK_FLOAT || _tok->type == TOK_BOOL)) {
+		e.kind = Event::Scalar;
+		e.type = _tok->type == TOK_INT ? Node::Int :
+				 _tok->type == TOK_FLOAT ? Node::Float :
+				 _tok->type == TOK_BOOL ? Node::Boolean :
+										  Node::String;
+		e.text.assign(_tok->contents.data(), _tok->contents.size());
+		next_token();
+		_step = ValueDone;
+		return true;
+	} else {
+		throw ParseException(token_line(), std::string("invalid value"));
+	}
+	Frame f;
+	f.type = e.type;
+	f.has_alias = _has_alias;
+	f.remaining = 0;
+	_stack.push_back(f);
+	_step = ContainerOpen;
+	return true;
+}
+
+// binary containers carry their member counts, so only ValueStart and
+// AfterValue are needed; anchors always come before their value
+bool Reader::next_binary(Event& e) {
+	for (;;) {
+		switch (_step) {
+			case ValueStart:
+				return begin_binary_value(e);
+			case AfterValue:
+				if (_stack.empty()) {
+					_step = Done;
+				} else if (_stack.back().remaining == 0) {
+					e.kind = Event::End;
+					e.type = _stack.back().type;
+					e.text.clear();
+					e.line = 0;
+					_stack.pop_back();
+					return true;
+				} else {
+					--_stack.back().remaining;
+					_step = ValueStart;
+					if (is_keyed(_stack.back().type)) {
+						std::string_view key = _bin.name();
+						e.kind = Event::Key;
+						e.text.assign(key.data(), key.size());
+						e.line = 0;
+						return true;
+					}
+				}
+				break;
+			case Done:
+			default:
+				return false;
+		}
+	}
+}
+
+bool Reader::begin_binary_value(Event& e) {
+	e.line = 0;
+	unsigned char tag = _bin.byte();
+	std::string_view name;
+	char buf[32];
+	std::to_chars_result r;
+	_step = AfterValue;
+	switch (tag) {
+		case BIN_ANCHOR:
+			name = _bin.name();
+			e.kind = Event::Alias;
+			e.text.assign(name.data(), name.size());
+			_step = ValueStart;
+			return true;
+		case BIN_STRING:
+			name = _bin.bytes(_bin.count());
+			e.kind = Event::Scalar;
+			e.type = Node::String;
+			e.text.assign(name.data(), name.size());
+			return true;
+		case BIN_INT:
+			r = std::to_chars(buf, buf + sizeof(buf), _bin.zigzag());
+			e.kind = Event::Scalar;
+			e.type = Node::Int;
+			e.text.assign(buf, r.ptr - buf);
+			return true;
+		case BIN_FLOAT:
+			r = std::to_chars(buf, buf + sizeof(buf), _bin.float64());
+			e.kind = Event::Scalar;
+			e.type = Node::Float;
+			e.text.assign(buf, r.ptr - buf);
+			return true;
+		case BIN_FALSE:
+		case BIN_TRUE:
+			e.kind = Event::Scalar;
+			e.type = Node::Boolean;
+			e.text = tag == BIN_TRUE ? "true" : "false";
+			return true;
+		case BIN_REFERENCE:
+		case BIN_LINK:
+			name = _bin.name();
+			e.kind = tag == BIN_LINK ? Event::Link : Event::Reference;
+			e.type = tag == BIN_LINK ? Node::Link : Node::Reference;
+			e.text.assign(name.data(), name.size());
+			return true;
+		case BIN_MAP:
+		case BIN_SEQUENCE:
+		case BIN_OBJMAP:
+		case BIN_OBJSEQUENCE: {
+			e.kind = tag == BIN_MAP ? Event::BeginMap :
+					 tag == BIN_SEQUENCE ? Event::BeginSeq :
+										   Event::BeginObject;
+			e.type = tag == BIN_MAP ? Node::Map :
+					 tag == BIN_SEQUENCE ? Node::Sequence :
+					 tag == BIN_OBJMAP ? Node::ObjMap :
+										 Node::ObjSequence;
+			e.text.clear();
+			if (tag == BIN_OBJMAP || tag == BIN_OBJSEQUENCE) {
+				name = _bin.name();
+				e.text.assign(name.data(), name.size());
+			}
+			Frame f;
+			f.type = e.type;
+			f.has_alias = false;
+			f.remaining = _bin.count();
+			if (_stack.size() >= BinaryCursor::max_depth) {
+				throw InputException(std::string("binary document nested too deeply"));
+			}
+			_stack.push_back(f);
+			return true;
+		}
+		default:
+			throw InputException(std::string("unknown tag in binary document"));
+	}
+}
+
+void Reader::next_token() {
+	_tok = _lexer.lex_token(_lookahead) ? &_lookahead : 0;
+}
+
+unsigned int Reader::token_line() {
+	return _tok ? _tok->line : _lexer.line();
+}
+
+bool Reader::expect(TokenType t) {
+	if (accept(t)) {
+		return true;
+	} else {
+		std::string str("unexpected token ");
+		str = str + (_tok ? tokentypes[_tok->type] : std::string("end of input")) + ", expected " + tokentypes[t];
+		throw ParseException(token_line(), str);
+	}
+}
+
+bool Reader::accept(TokenType t) {
+	if (_tok && _tok->type == t) {
+		next_token();
+		return true;
+	}
+	return false;
+}
+
+// reuses the capacity of the event's text
+void Reader::take_identifier(std::string& name) {
+	if (!_tok || _tok->type != TOK_IDENTIFIER) {
+		expect(TOK_IDENTIFIER);
+	}
+	name.assign(_tok->contents.data(), _tok->contents.size());
+	next_token();
+}
+
+TokenType Reader::closing(Node::NodeType type) {
+	return type == Node::Map ? TOK_CBRACE_R :
+		   type == Node::Sequence ? TOK_SBRACE_R :
+									TOK_RBRACE_R;
+}
+
+bool Reader::is_keyed(Node::NodeType type) {
+	return type == Node::Map || type == Node::ObjMap;
+}
@@ -0,0 +1,172 @@
+#include "parser.h"
+#include <cstring>
+
+#if !defined(DMON_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#define DMON_HAVE_SSE2
+#include <emmintrin.h>
+#if !defined(DMON_NO_AVX2) && defined(__GNUC__)
+#define DMON_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+enum {
+	CLASS_SPACE = 1,
+	CLASS_WORD = 2,
+	CLASS_STOP = 4,
+	CLASS_NEWLINE = 8
+};
+
+struct ClassTable {
+	unsigned char k[256];
+	ClassTable() {
+		for (int c = 0; c < 256; ++c) {
+			k[c] = 0;
+			if (c == 0x09 || (c >= 0x0A && c <= 0x0D) || c == 0x20) k[c] |= CLASS_SPACE;
+			if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_') k[c] |= CLASS_WORD;
+			if (c == '"' || c == '\\' || c == '#') k[c] |= CLASS_STOP;
+			if (c == '\n') k[c] |= CLASS_NEWLINE;
+		}
+	}
+};
+
+static const ClassTable& classes() {
+	static const ClassTable table;
+	return table;
+}
+
+#ifdef DMON_HAVE_SSE2
+// a byte lies in [lo, lo + n] when its distance from lo, taken unsigned,
+// is no more than n, which is when the smaller of the two is the distance
+static inline __m128i in_range(__m128i c, char lo, char n) {
+	__m128i d = _mm_sub_epi8(c, _mm_set1_epi8(lo));
+	return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(n)), d);
+}
+
+static void classify_sse2(const char* p, StructuralIndex::Block& b) {
+	b.space = b.word = b.stop = b.newline = 0;
+	for (int i = 0; i < 64; i += 16) {
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		__m128i space = _mm_or_si128(in_range(c, 0x09, 4), _mm_cmpeq_epi8(c, _mm_set1_epi8(' ')));
+		__m128i word = _mm_or_si128(
+			_mm_or_si128(in_range(c, '0', 9), in_range(_mm_or_si128(c, _mm_set1_epi8(0x20)), 'a', 25)),
+			_mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+		__m128i stop = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('"')), _mm_cmpeq_epi8(c, _mm_set1_epi8('\\'))),
+			_mm_cmpeq_epi8(c, _mm_set1_epi8('#')));
+		__m128i newline = _mm_cmpeq_epi8(c, _mm_set1_epi8('\n'));
+		b.space |= (std::uint64_t)(unsigned int)_mm_movemask_epi8(space) << i;
+		b.word |= (std::uint64_t)(unsigned int)_mm_movemask_epi8(word) << i;
+		b.stop |= (std::uint64_t)(unsigned int)_mm_movemask_epi8(stop) << i;
+		b.newline |= (std::uint64_t)(unsigned int)_mm_movemask_epi8(newline) << i;
+	}
+}
+#endif
+
+#ifdef DMON_HAVE_AVX2
+__attribute__((target("avx2")))
+static inline __m256i in_range_avx2(__m256i c, char lo, char n) {
+	__m256i d = _mm256_sub_epi8(c, _mm256_set1_epi8(lo));
+	return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(n)), d);
+}
+
+__attribute__((target("avx2")))
+static void classify_avx2(const char* p, StructuralIndex::Block& b) {
+	b.space = b.word = b.stop = b.newline = 0;
+	for (int i = 0; i < 64; i += 32) {
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+		__m256i space = _mm256_or_si256(in_range_avx2(c, 0x09, 4), _mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')));
+		__m256i word = _mm256_or_si256(
+			_mm256_or_si256(in_range_avx2(c, '0', 9), in_range_avx2(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), 'a', 25)),
+			_mm256_cmpeq_epi8(c, _mm256_set1_epi8('_')));
+		__m256i stop = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\\'))),
+			_mm256_cmpeq_epi8(c, _mm256_set1_epi8('#')));
+		__m256i newline = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n'));
+		b.space |= (std::uint64_t)(unsigned int)_mm256_movemask_epi8(space) << i;
+		b.word |= (std::uint64_t)(unsigned int)_mm256_movemask_epi8(word) << i;
+		b.stop |= (std::uint64_t)(unsigned int)_mm256_movemask_epi8(stop) << i;
+		b.newline |= (std::uint64_t)(unsigned int)_mm256_movemask_epi8(newline) << i;
+	}
+}
+#endif
+
+StructuralIndex::Classifier StructuralIndex::classifier() {
+	static const Classifier picked =
+#ifdef DMON_HAVE_AVX2
+		__builtin_cpu_supports("avx2") ? classify_avx2 :
+#endif
+#ifdef DMON_HAVE_SSE2
+		classify_sse2;
+#else
+		0;
+#endif
+	return picked;
+}
+
+const char* StructuralIndex::level() {
+#ifdef DMON_HAVE_AVX2
+	if (classifier() == classify_avx2) return "avx2";
+#endif
+#ifdef DMON_HAVE_SSE2
+	if (classifier() == classify_sse2) return "sse2";
+#endif
+	return "scalar";
+}
+
+// the last block of the input is classified from a padded copy; the padding
+// is NUL, which is in no class, and counts as a stop, so that every run
+// ends at the end of the input at the latest
+void StructuralIndex::classify(const char* p) {
+	_block = p;
+	if (_end - p >= 64) {
+		classifier()(p, _masks);
+	} else {
+		char padded[64];
+		std::memset(padded, 0, sizeof(padded));
+		std::memcpy(padded, p, _end - p);
+		classifier()(padded, _masks);
+		_masks.stop |= ~(std::uint64_t)0 << (_end - p);
+	}
+}
+
+// the block boundaries are wherever a run left the previous block, so
+// consecutive blocks are contiguous and each byte is classified once
+const char* StructuralIndex::run(const char* p, Kind kind, unsigned int* lines) {
+	if (!classifier()) {
+		return run_bytes(p, kind, lines);
+	}
+	for (;;) {
+		std::uint64_t offset = (std::uintptr_t)p - (std::uintptr_t)_block;
+		if (offset >= 64) {
+			if (p >= _end) {
+				return _end;
+			}
+			classify(p);
+			offset = 0;
+		}
+		std::uint64_t ends = kind == Space ? ~_masks.space : kind == Word ? ~_masks.word : _masks.stop;
+		ends >>= offset;
+		if (ends) {
+			unsigned int n = first_bit(ends);
+			if (lines) *lines += count_lines(offset, n);
+			return p + n;
+		}
+		if (lines) *lines += bit_count(_masks.newline >> offset);
+		p = _block + 64;
+	}
+}
+
+const char* StructuralIndex::run_bytes(const char* p, Kind kind, unsigned int* lines) {
+	const ClassTable& table = classes();
+	unsigned char bit = kind == Space ? CLASS_SPACE : kind == Word ? CLASS_WORD : CLASS_STOP;
+	unsigned char ends = kind == Stop ? bit : 0;
+	for (; p != _end; ++p) {
+		unsigned char k = table.k[(unsigned char)*p];
+		if ((k & bit) == ends) {
+			break;
+		}
+		if (lines && (k & CLASS_NEWLINE)) ++*lines;
+	}
+	return p;
+}
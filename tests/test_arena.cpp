@@ -0,0 +1,56 @@
+// a document takes its nodes from an upstream resource in a few large
+// blocks and gives all of them back at once
+#include "../parser.h"
+#include <iostream>
+#include <string>
+#include <memory_resource>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+class Counter: public std::pmr::memory_resource {
+public:
+	std::size_t allocations, outstanding;
+	Counter(): allocations(0), outstanding(0) {}
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) {
+		++allocations;
+		outstanding += bytes;
+		return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+	}
+	void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) {
+		outstanding -= bytes;
+		std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+	}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+		return this == &other;
+	}
+};
+
+int main() {
+	std::string text = "[";
+	for (int i = 0; i < 20000; ++i) {
+		text += (i ? ", " : "") + std::string("!Item(id: ") + std::to_string(i) + ", name: \"item\", tags: [1, 2])";
+	}
+	text += "]";
+	Counter counter;
+	try {
+		Parser parser(text.data(), text.data() + text.size(), &counter);
+		Node& root = parser.get_document();
+		int id;
+		root[19999]["id"] >> id;
+		check(id == 19999 && root.size() == 20000, "the document");
+		check(counter.allocations > 0 && counter.allocations < 64, "nodes come from a few blocks");
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	check(counter.outstanding == 0, "every block is given back with the parser");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+// the binary form decodes to the document it was encoded from, and a cut
+// short or too deeply nested one is refused
+#include "../parser.h"
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static std::string emit(Document& doc) {
+	std::string out;
+	Emitter e(out);
+	e.write(doc);
+	e.flush();
+	return out;
+}
+
+static std::string encode(const std::string& text) {
+	Parser parser(text.data(), text.data() + text.size());
+	parser.get_document();
+	std::string out;
+	Encoder e(out);
+	e.write(parser.document());
+	return out;
+}
+
+static std::string events(const std::string& text) {
+	Reader reader(text.data(), text.data() + text.size());
+	Reader::Event e;
+	std::string out;
+	while (reader.next(e)) {
+		out += std::to_string(e.kind) + "." + std::to_string(e.type) + ":" + e.text + " ";
+	}
+	return out;
+}
+
+static const char *texts[] = {
+	"{a: 1, b: [2.5, -3, true, false, \"s\\\"\\#\"], c: {}, d: [], e: -9223372036854775808}",
+	"[&x {k: \"v\"}, *x, @x, !P(x: 1, y: &n 2), !Q(*n, \"q\"), !E()]",
+	"\"just a string\"",
+};
+
+static void round_trips() {
+	for (std::size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+		std::string text = texts[i], binary = encode(text);
+		check(BinaryCursor::is_binary(binary.data(), binary.data() + binary.size()), "a binary header");
+		Parser parser(text.data(), text.data() + text.size());
+		parser.get_document();
+		Parser decoded(binary.data(), binary.data() + binary.size());
+		decoded.get_document();
+		check(emit(decoded.document()) == emit(parser.document()), std::string("decoding ") + texts[i]);
+		check(events(binary) == events(text), std::string("reading the binary form of ") + texts[i]);
+	}
+}
+
+static bool refused(const std::string& binary) {
+	Parser parser(binary.data(), binary.data() + binary.size());
+	try {
+		parser.get_document();
+	} catch (InputException&) {
+		return true;
+	}
+	return false;
+}
+
+static bool refused_by_reader(const std::string& binary) {
+	try {
+		events(binary);
+	} catch (InputException&) {
+		return true;
+	}
+	return false;
+}
+
+// every prefix of an encoding, and the encoding with a byte more, is refused
+static void truncation() {
+	std::string binary = encode(texts[1]);
+	bool all = true;
+	for (std::size_t n = 5; n < binary.size(); ++n) {
+		all = all && refused(binary.substr(0, n)) && refused_by_reader(binary.substr(0, n));
+	}
+	check(all, "a truncated binary document");
+	check(refused(binary + '\0'), "trailing bytes");
+	std::string other = binary;
+	other[4] = 2;
+	check(refused(other), "another version");
+}
+
+// sequences of one element, nested depth deep
+static std::string nested(unsigned int depth) {
+	std::string binary(BinaryCursor::magic, 4);
+	binary += (char)BinaryCursor::version;
+	binary += '\0';
+	for (unsigned int i = 0; i < depth; ++i) {
+		binary += (char)BIN_SEQUENCE;
+		binary += '\1';
+	}
+	binary += (char)BIN_INT;
+	binary += '\0';
+	return binary;
+}
+
+static void depth() {
+	check(!refused(nested(BinaryCursor::max_depth)), "nesting up to the limit");
+	check(refused(nested(BinaryCursor::max_depth + 1)), "nesting past the limit");
+	check(!refused_by_reader(nested(BinaryCursor::max_depth)), "reading nesting up to the limit");
+	check(refused_by_reader(nested(BinaryCursor::max_depth + 1)), "reading nesting past the limit");
+}
+
+int main() {
+	try {
+		round_trips();
+		truncation();
+		depth();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+// bindings must compile for any set of distinct keys, and read back what
+// the document holds
+#include "../parser.h"
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Endpoint {
+	std::string host;
+	std::vector<int> ports;
+	double w;
+	std::vector<int> ids;
+};
+
+// "host" and "ids" fell in the same slot under every seed of the old hash
+template<> struct Binding<Endpoint> {
+	static constexpr auto fields = bind_class("Endpoint", field("host", &Endpoint::host),
+		field("ports", &Endpoint::ports), field("w", &Endpoint::w), field("ids", &Endpoint::ids));
+};
+
+static_assert(Binding<Endpoint>::fields.find("host") == 0, "host");
+static_assert(Binding<Endpoint>::fields.find("ports") == 1, "ports");
+static_assert(Binding<Endpoint>::fields.find("w") == 2, "w");
+static_assert(Binding<Endpoint>::fields.find("ids") == 3, "ids");
+static_assert(Binding<Endpoint>::fields.find("port") == -1, "not a key");
+
+#define WIDE(X) X(id) X(name) X(host) X(port) X(user) X(group) X(mode) X(path) X(root) X(home) \
+	X(shell) X(term) X(lang) X(zone) X(retries) X(timeout) X(delay) X(limit) X(depth) X(width) \
+	X(height) X(x) X(y) X(z) X(w) X(r) X(g) X(b) X(a) X(ids) X(idx) X(key) X(value) X(size) \
+	X(count) X(first) X(last) X(next) X(prev) X(parent) X(child) X(left) X(right) X(top) X(bottom) \
+	X(min) X(max) X(sum) X(avg)
+
+struct Wide {
+#define MEMBER(k) int k;
+	WIDE(MEMBER)
+	int level;
+};
+
+template<> struct Binding<Wide> {
+#define FIELD(k) field(#k, &Wide::k),
+	static constexpr auto fields = bind_class("Wide", WIDE(FIELD) field("level", &Wide::level));
+};
+
+constexpr bool finds_every_key() {
+	int i = 0;
+#define FINDS(k) if (Binding<Wide>::fields.find(#k) != i++) return false;
+	WIDE(FINDS)
+	return Binding<Wide>::fields.find("level") == i && Binding<Wide>::fields.find("port_") == -1 && Binding<Wide>::fields.find("") == -1;
+}
+
+static_assert(finds_every_key(), "every key of a wide class");
+static_assert(sizeof(Binding<Wide>::fields.table) + sizeof(Binding<Wide>::fields.displacement) <= 8 * 51 + 2 * 51,
+	"the tables of a wide class");
+
+static bool fails(const char* text, const char* message) {
+	Reader reader(text, text + std::strlen(text));
+	Binder binder(reader);
+	Endpoint e;
+	try {
+		binder.read(e);
+	} catch (BindException& ex) {
+		if (std::string(ex.what()).find(message) != std::string::npos) {
+			return true;
+		}
+		std::cerr << "failed: " << text << " gave " << ex.what() << std::endl;
+		return false;
+	}
+	std::cerr << "failed: " << text << " was read" << std::endl;
+	return false;
+}
+
+int main() {
+	std::string text = "!Endpoint(host: \"a\", ports: [80, 443], w: 0.5, ids: [7])";
+	Reader reader(text.data(), text.data() + text.size());
+	Binder binder(reader);
+	Endpoint e;
+	try {
+		binder.read(e);
+	} catch (std::exception& ex) {
+		std::cerr << "failed: " << ex.what() << std::endl;
+		return 1;
+	}
+	if (e.host != "a" || e.ports.size() != 2 || e.ports[1] != 443 || e.w != 0.5 || e.ids.size() != 1 || e.ids[0] != 7) {
+		std::cerr << "failed: fields read back" << std::endl;
+		return 1;
+	}
+	if (!fails("!Endpoint(ports: [99999999999999999999])", "integer out of range") ||
+		!fails("!Endpoint(w: 1e999)", "number out of range") ||
+		!fails("!Endpoint(w: 1)", "expected Float")) {
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,68 @@
+// references and links that lead back to the value holding them are
+// refused, however they are nested, and long acyclic chains are not
+#include "../parser.h"
+#include <iostream>
+#include <string>
+#include <chrono>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static bool cyclic(const std::string& text) {
+	Parser parser(text.data(), text.data() + text.size());
+	try {
+		parser.get_document();
+	} catch (ValidateException& e) {
+		return std::string(e.what()).find("cycl") != std::string::npos;
+	}
+	return false;
+}
+
+static void cycles_and_chains() {
+	const char *cycles[] = {
+		"{a: &x [*x]}",
+		"{a: &x {b: @x}}",
+		"[&x [&y [*x]], *y]",
+		"{a: &x [*y], b: &y [*z], c: &z [@x]}",
+		"!P(a: &x !Q(*x))",
+	};
+	for (std::size_t i = 0; i < sizeof(cycles) / sizeof(cycles[0]); ++i) {
+		check(cyclic(cycles[i]), std::string("a cycle in ") + cycles[i]);
+	}
+	const char *acyclic[] = {
+		"{a: &x [1], b: *x, c: [*x, @x]}",
+		"{a: &x [&y 1, *y], b: *x}",
+		"[&x {}, &y [*x], &z [*y, *x]]",
+	};
+	for (std::size_t i = 0; i < sizeof(acyclic) / sizeof(acyclic[0]); ++i) {
+		check(!cyclic(acyclic[i]), std::string("no cycle in ") + acyclic[i]);
+	}
+	// each alias refers to the one before it; checking the chain takes time
+	// in proportion to its length
+	std::string chain = "[&a0 [0]";
+	for (int i = 1; i < 20000; ++i) {
+		chain += ", &a" + std::to_string(i) + " [*a" + std::to_string(i - 1) + "]";
+	}
+	chain += "]";
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	check(!cyclic(chain), "a long chain");
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	check(seconds < 5, "a long chain is checked in linear time");
+	check(cyclic(chain.substr(0, chain.size() - 1) + ", &b [*a19999, [*b]]]"), "a cycle at the end of a long chain");
+}
+
+int main() {
+	try {
+		cycles_and_chains();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+// parsing writes nothing unless a sink is installed, and a sink only gets
+// the records at or below its level
+#include "../parser.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static const char *text = "{a: &x [1, 2], b: &y [*x], c: [@y]}";
+
+static void silent_by_default() {
+	std::ostringstream out, err;
+	std::streambuf *old_out = std::cout.rdbuf(out.rdbuf());
+	std::streambuf *old_err = std::cerr.rdbuf(err.rdbuf());
+	for (int single_pass = 0; single_pass < 2; ++single_pass) {
+		Parser parser(text, text + std::strlen(text));
+		parser.set_single_pass(single_pass != 0);
+		parser.get_document();
+	}
+	std::cout.rdbuf(old_out);
+	std::cerr.rdbuf(old_err);
+	check(out.str().empty() && err.str().empty(), "nothing is written without a sink");
+}
+
+static std::vector<Diagnostics::Record> records(Diagnostics::Level level) {
+	std::vector<Diagnostics::Record> got;
+	Parser parser(text, text + std::strlen(text));
+	parser.set_diagnostics(level, [&got](const Diagnostics::Record& r) {
+		got.push_back(r);
+	});
+	parser.get_document();
+	return got;
+}
+
+static void levels() {
+	std::vector<Diagnostics::Record> info = records(Diagnostics::Info);
+	bool phases = !info.empty(), lexed = false;
+	for (std::size_t i = 0; i < info.size(); ++i) {
+		phases = phases && info[i].level == Diagnostics::Info && info[i].channel == Diagnostics::Phases;
+		lexed = lexed || std::string(info[i].phase) == "lex";
+	}
+	check(phases && lexed, "phase timings at Info");
+	std::vector<Diagnostics::Record> trace = records(Diagnostics::Trace);
+	std::size_t tokens = 0, edges = 0;
+	for (std::size_t i = 0; i < trace.size(); ++i) {
+		tokens += trace[i].channel == Diagnostics::Tokens;
+		edges += trace[i].channel == Diagnostics::Cycles;
+	}
+	check(tokens >= 20, "every token at Trace");
+	check(edges == 1, "the alias edge at Trace");
+	check(records(Diagnostics::Silent).empty(), "nothing when silent");
+}
+
+int main() {
+	try {
+		silent_by_default();
+		levels();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,53 @@
+// documents keep their anchors to themselves, so the same alias names can
+// be loaded by several parsers at once
+#include "../parser.h"
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+
+static std::atomic<int> failures(0);
+
+static void check(bool ok, const std::string& what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static void load(int id) {
+	for (int round = 0; round < 200; ++round) {
+		std::string n = std::to_string(id * 1000 + round);
+		std::string text = "{shared: &x " + n + ", other: &y [" + n + "], a: *x, b: @y}";
+		Parser parser(text.data(), text.data() + text.size());
+		Node& root = parser.get_document();
+		int a, b;
+		root["a"] >> a;
+		root["b"][0] >> b;
+		check(std::to_string(a) == n && std::to_string(b) == n, "the document's own anchors in thread " + std::to_string(id));
+		check(parser.document().anchors().size() == 2, "two anchors");
+	}
+}
+
+int main() {
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; ++i) {
+		threads.push_back(std::thread(load, i + 1));
+	}
+	for (std::size_t i = 0; i < threads.size(); ++i) {
+		threads[i].join();
+	}
+	// anchors end with their document, so loading the same names again is
+	// not a redefinition
+	std::string text = "{shared: &x 1, a: *x}";
+	try {
+		Parser first(text.data(), text.data() + text.size());
+		first.get_document();
+		Parser second(text.data(), text.data() + text.size());
+		second.get_document();
+	} catch (std::exception& e) {
+		check(false, e.what());
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+// what the Emitter writes loads back as the same document, in either style
+#include "../parser.h"
+#include <iostream>
+#include <string>
+#include <cmath>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static std::string emit(Document& doc, Emitter::Style style) {
+	std::string out;
+	Emitter e(out, style);
+	e.write(doc);
+	e.flush();
+	return out;
+}
+
+// loading the text and writing it out gives text that loads back to the
+// same document, and writes out unchanged
+static void round_trips() {
+	const char *texts[] = {
+		"{a: 1, b: [2.5, -3, true, false, \"s\"], c: {}, d: []}",
+		"[&x {k: \"v\"}, *x, @x, !P(x: 1, y: &n 2), !Q(*n, \"q\"), !E()]",
+		"{f: [1e300, -0.0, 0.1, 2e-5, 3.0]}",
+		"{deep: [[[[{a: [[]]}]]]]}",
+	};
+	for (std::size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+		for (int style = 0; style < 2; ++style) {
+			Parser parser(texts[i], texts[i] + std::string(texts[i]).size());
+			parser.get_document();
+			std::string once = emit(parser.document(), (Emitter::Style)style);
+			Parser again(once.data(), once.data() + once.size());
+			again.get_document();
+			std::string twice = emit(again.document(), (Emitter::Style)style);
+			check(once == twice, std::string("round trip of ") + texts[i] + ": " + once + " then " + twice);
+		}
+	}
+}
+
+// quotes, backslashes and '#', which would start a comment, are escaped
+static void escapes() {
+	std::string value = "a#b\"c\\d\\ne\n#f";
+	std::string out;
+	Emitter e(out);
+	e.begin_map();
+	e.key("s");
+	e.value(value);
+	e.key("n");
+	e.value(1.0);
+	e.end();
+	e.flush();
+	Parser parser(out.data(), out.data() + out.size());
+	Node& root = parser.get_document();
+	std::string s;
+	root["s"] >> s;
+	check(s == value, "an escaped string reads back: " + out);
+	check(root["n"].get_type() == Node::Float, "a whole float stays a float: " + out);
+}
+
+static bool refused(void (*f)(Emitter&)) {
+	std::string out;
+	Emitter e(out);
+	try {
+		f(e);
+	} catch (EmitException&) {
+		return true;
+	}
+	return false;
+}
+
+static void errors() {
+	check(refused([](Emitter& e) {e.end();}), "an end outside a container");
+	check(refused([](Emitter& e) {e.begin_map(); e.key("k"); e.end();}), "a key without a value");
+	check(refused([](Emitter& e) {e.begin_map(); e.key("not a name");}), "a key that is not an identifier");
+	check(refused([](Emitter& e) {e.value(std::nan(""));}), "a NaN");
+}
+
+int main() {
+	try {
+		round_trips();
+		escapes();
+		errors();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+// an image reads in place as the document it was written from, and one
+// with a bad header or offset is refused
+#include "../parser.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+// an image in a buffer aligned as a mapping would be, shifted by offset bytes
+struct Buffer {
+	std::vector<std::uint64_t> words;
+	const char *begin, *end;
+	Buffer(const std::string& bytes, std::size_t offset = 0): words((bytes.size() + offset) / 8 + 1) {
+		char *p = reinterpret_cast<char*>(&words[0]) + offset;
+		std::memcpy(p, bytes.data(), bytes.size());
+		begin = p;
+		end = p + bytes.size();
+	}
+};
+
+static std::string write(const std::string& text) {
+	Parser parser(text.data(), text.data() + text.size());
+	parser.get_document();
+	std::string out;
+	ImageWriter w(out);
+	w.write(parser.document());
+	return out;
+}
+
+static int read_int(ImageNode n) {
+	int v;
+	n >> v;
+	return v;
+}
+
+static void reading() {
+	std::string text = "{name: \"dmon\", list: [5, 3, 9, 1], pi: 3.25, on: true, anchored: &x {k: \"v\"}, ref: *x, "
+		"objects: [!P(x: 1, y: 2), !Q(1, 2)], big: {";
+	for (int i = 0; i < 50; ++i) {
+		text += (i ? ", k" : "k") + std::to_string(i) + ": " + std::to_string(i);
+	}
+	text += "}}";
+	Buffer b(write(text));
+	Image image(b.begin, b.end);
+	ImageNode root = image.root();
+	std::string s;
+	root["name"] >> s;
+	double pi;
+	root["pi"] >> pi;
+	bool on;
+	root["on"] >> on;
+	check(s == "dmon" && pi == 3.25 && on && root["name"].view() == "dmon", "scalars");
+	check(root["ref"]["k"].view() == "v" && image.get_anchor("x")["k"].view() == "v", "a reference and an anchor");
+	check(root["objects"][0].get_class_name() == "P" && read_int(root["objects"][1][1]) == 2, "objects");
+	bool found = root["big"].size() == 50;
+	for (int i = 0; i < 50; ++i) {
+		found = found && read_int(root["big"]["k" + std::to_string(i)]) == i;
+	}
+	check(found && !root["big"].find("k50"), "a map with an index");
+	check(!root.find("missing"), "a missing key");
+	ImageNode list = root["list"];
+	ImageNode::iterator first = list.begin(), last = list.end();
+	check(last - first == 4 && first < last && last > first && first <= first && last >= first, "iterator comparisons");
+	check(read_int(first[2]) == 9 && read_int(*(2 + first)) == 9 && read_int(*(last - 1)) == 1, "iterator arithmetic");
+	ImageNode::iterator most = std::max_element(first, last, [](ImageNode a, ImageNode b) {
+		return read_int(a) < read_int(b);
+	});
+	check(most - first == 2, "max_element over an image");
+	std::string keys;
+	for (ImageNode::iterator it = root.begin(); it != root.end(); ++it) {
+		keys += std::string(it.key()) + " ";
+	}
+	check(keys == "anchored big list name objects on pi ref ", "keys in order: " + keys);
+}
+
+static bool refused(const Buffer& b) {
+	try {
+		Image image(b.begin, b.end);
+		image.root();
+	} catch (InputException&) {
+		return true;
+	}
+	return false;
+}
+
+static void headers() {
+	std::string image = write("{a: [1, 2, 3]}");
+	ImageHeader h;
+	std::memcpy(&h, image.data(), sizeof(h));
+	check(!refused(Buffer(image)), "a good image");
+	check(refused(Buffer(image, 4)), "a misaligned image");
+	check(refused(Buffer(image.substr(0, sizeof(ImageHeader) - 1))), "a cut header");
+	check(refused(Buffer(image.substr(0, image.size() - 8))), "a cut image");
+	std::string bad = image;
+	bad[0] = 'X';
+	check(refused(Buffer(bad)), "a bad magic");
+	ImageHeader changed = h;
+	changed.version = Image::version + 1;
+	check(refused(Buffer(std::string((const char*)&changed, sizeof(changed)) + image.substr(sizeof(changed)))), "another version");
+	changed = h;
+	changed.byte_order = 0x04030201;
+	check(refused(Buffer(std::string((const char*)&changed, sizeof(changed)) + image.substr(sizeof(changed)))), "another byte order");
+	changed = h;
+	changed.root = (std::uint32_t)image.size();
+	check(refused(Buffer(std::string((const char*)&changed, sizeof(changed)) + image.substr(sizeof(changed)))), "a root out of bounds");
+	changed = h;
+	changed.root = sizeof(ImageHeader) + 4;
+	check(refused(Buffer(std::string((const char*)&changed, sizeof(changed)) + image.substr(sizeof(changed)))), "a misaligned root");
+	changed = h;
+	changed.anchor_count = 1000;
+	check(refused(Buffer(std::string((const char*)&changed, sizeof(changed)) + image.substr(sizeof(changed)))), "an anchor table out of bounds");
+}
+
+int main() {
+	try {
+		reading();
+		headers();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
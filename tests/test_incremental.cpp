@@ -0,0 +1,379 @@
+// checks the incremental mode against fresh loads of the same text
+#include "../parser.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <unordered_set>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static long long read_int(Node& n) {
+	long long v;
+	n >> v;
+	return v;
+}
+
+static std::string emit(Document& doc) {
+	std::string out;
+	Emitter e(out);
+	e.write(doc);
+	e.flush();
+	return out;
+}
+
+// the nodes of the tree, without following references
+static void collect(Node& n, std::unordered_set<Node*>& nodes) {
+	nodes.insert(&n);
+	Node::NodeType t = n.get_type();
+	if (t == Node::Map || t == Node::ObjMap || t == Node::Sequence || t == Node::ObjSequence) {
+		for (Node::iterator it = n.begin(); it != n.end(); ++it) {
+			collect(**it, nodes);
+		}
+	}
+}
+
+static bool refers_within(Node& n, std::unordered_set<Node*>& nodes) {
+	Node::NodeType t = n.get_type();
+	if (t == Node::Reference || t == Node::Link) {
+		return nodes.count(n.resolve()) != 0;
+	}
+	if (t == Node::Map || t == Node::ObjMap || t == Node::Sequence || t == Node::ObjSequence) {
+		for (Node::iterator it = n.begin(); it != n.end(); ++it) {
+			if (!refers_within(**it, nodes)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// the updated document reads as a fresh load of its text does, and its
+// anchors and references point into its own tree
+static bool matches(Parser& updated, const std::string& text) {
+	Parser fresh(text.data(), text.data() + text.size());
+	fresh.get_document();
+	Document& doc = updated.document();
+	if (emit(doc) != emit(fresh.document()) || doc.anchors().size() != fresh.document().anchors().size()) {
+		return false;
+	}
+	std::unordered_set<Node*> nodes;
+	collect(doc.root(), nodes);
+	for (Document::anchor_table::iterator it = doc.anchors().begin(); it != doc.anchors().end(); ++it) {
+		if (!nodes.count((*it).second)) {
+			return false;
+		}
+	}
+	return refers_within(doc.root(), nodes);
+}
+
+static bool loads(const std::string& text) {
+	try {
+		Parser fresh(text.data(), text.data() + text.size());
+		fresh.get_document();
+		return true;
+	} catch (std::exception&) {
+		return false;
+	}
+}
+
+// incremental loading takes precedence over lazy loading and threads
+static void lazy_and_threads_are_ignored() {
+	std::string text = "{a: 1, b: {c: [1, 2, 3], e: 7}, d: {f: \"x\"}}";
+	for (int mode = 0; mode < 2; ++mode) {
+		Parser parser(text.data(), text.data() + text.size());
+		parser.set_incremental(true);
+		if (mode == 0) {
+			parser.set_lazy(true);
+		} else {
+			parser.set_threads(4);
+		}
+		Node& root = parser.get_document();
+		check(read_int(root["b"]["e"]) == 7, "first load");
+		std::string edited = "{a: 1, b: {c: [1, 2, 3], e: 8}, d: {f: \"x\"}}";
+		Node& updated = parser.update(edited.data(), edited.data() + edited.size());
+		check(read_int(updated["b"]["e"]) == 8, "update");
+		check(read_int(updated["b"]["c"][2]) == 3, "member taken over");
+	}
+}
+
+// an accessor bound to the document reaches the new nodes after an update
+static void accessors_follow_updates() {
+	std::string text = "{a: 1, b: {c: [1, 2, 3], e: 7}, d: {f: \"x\"}}";
+	Parser parser(text.data(), text.data() + text.size());
+	parser.set_incremental(true);
+	parser.get_document();
+	Accessor e("b.e", parser.document());
+	Accessor all("b.*", parser.document());
+	check(read_int(*e) == 7 && all.all().size() == 2, "accessor before the update");
+	std::string edited = "{a: 1, b: {c: [1, 2, 3], e: 8, g: 9}, d: {f: \"x\"}}";
+	parser.update(edited.data(), edited.data() + edited.size());
+	check(read_int(*e) == 8, "accessor after an update");
+	check(all.all().size() == 3, "listing after an update");
+	std::string rewritten = "[0, {b: {e: 10}}]";
+	Node& root = parser.update(rewritten.data(), rewritten.data() + rewritten.size());
+	check(root.get_type() == Node::Sequence && !e.get(), "accessor after the root is replaced");
+}
+
+// references elsewhere see the members an edit inside the anchored
+// container put there, and a new anchor inside it can be referred to
+static void edits_inside_an_anchored_container() {
+	std::string text = "{a: &base {x: 1, y: [1, 2]}, b: *base, c: {d: @base}}";
+	Parser parser(text.data(), text.data() + text.size());
+	parser.set_incremental(true);
+	parser.get_document();
+	std::string edited = "{a: &base {x: 2, y: [1, 2, &two 3]}, b: *base, c: {d: @base, e: *two}}";
+	Node& root = parser.update(edited.data(), edited.data() + edited.size());
+	check(read_int(root["b"]["x"]) == 2 && read_int(root["c"]["d"]["x"]) == 2, "reference into an edited anchor");
+	check(read_int(root["c"]["e"]) == 3, "reference to an anchor the edit added");
+	check(matches(parser, edited), "anchored container against a fresh load");
+	std::string renamed = "{a: &base {x: 2, y: [1, 2, &three 3]}, b: *base, c: {d: @base, e: *three}}";
+	parser.update(renamed.data(), renamed.data() + renamed.size());
+	check(matches(parser, renamed), "renamed anchor against a fresh load");
+	std::string dropped = "{a: &base {x: 2, y: [1, 2, 3]}, b: *base, c: {d: @base, e: *three}}";
+	bool thrown = false;
+	try {
+		parser.update(dropped.data(), dropped.data() + dropped.size());
+	} catch (ValidateException&) {
+		thrown = true;
+	}
+	check(thrown && matches(parser, renamed), "removing an anchor still referred to");
+}
+
+// an edit that closes a cycle is refused and leaves the document as it was
+static void edits_that_add_a_cycle() {
+	std::string text = "{a: &x {b: &y [1, 2]}, c: &z {d: *y}}";
+	Parser parser(text.data(), text.data() + text.size());
+	parser.set_incremental(true);
+	parser.get_document();
+	const char* cycles[] = {
+		"{a: &x {b: &y [1, *x]}, c: &z {d: *y}}",
+		"{a: &x {b: &y [1, *z]}, c: &z {d: *y}}",
+		"{a: &x {b: &y [1, 2], e: *x}, c: &z {d: *y}}",
+		"{a: &x {b: &y [1, 2]}, c: &z {d: *y, e: [@z]}}"
+	};
+	for (std::size_t i = 0; i < sizeof(cycles) / sizeof(cycles[0]); ++i) {
+		std::string edited = cycles[i];
+		bool thrown = false;
+		try {
+			parser.update(edited.data(), edited.data() + edited.size());
+		} catch (ValidateException&) {
+			thrown = true;
+		}
+		check(thrown && matches(parser, text), "cycle refused");
+	}
+	std::string edited = "{a: &x {b: &y [1, *z]}, c: &z {d: 2}}";
+	parser.update(edited.data(), edited.data() + edited.size());
+	check(matches(parser, edited), "the edge back removed first");
+}
+
+// the other update takes the edit itself
+static void edits_by_range() {
+	std::string text = "{a: [1, 2, 3], b: {c: 4}}";
+	Parser parser(text.data(), text.data() + text.size());
+	parser.set_incremental(true);
+	Node& root = parser.update(text.find('4'), 1, "40, d: [5]");
+	check(read_int(root["b"]["c"]) == 40 && read_int(root["b"]["d"][0]) == 5, "range update");
+	check(matches(parser, "{a: [1, 2, 3], b: {c: 40, d: [5]}}"), "range update against a fresh load");
+	bool thrown = false;
+	try {
+		parser.update(100, 1, "x");
+	} catch (InputException&) {
+		thrown = true;
+	}
+	check(thrown, "range outside the text");
+}
+
+// a random document from a few names, so that anchors are defined twice,
+// references dangle and cycles form now and then
+struct Value {
+	int kind; // 0 int, 1 string, 2 map, 3 sequence, 4 object, 5 reference, 6 link
+	long long n;
+	std::string alias;
+	std::vector<std::pair<std::string,Value> > members;
+};
+
+static const char* alias_names[] = {"a", "b", "c", "d", "e"};
+
+static Value random_value(std::mt19937& rng, int depth) {
+	Value v;
+	v.kind = (int)(rng() % (depth > 3 ? 2 : 7));
+	v.n = (long long)(rng() % 1000);
+	if ((v.kind < 5 && rng() % 6 == 0)) {
+		v.alias = alias_names[rng() % 5];
+	}
+	if (v.kind >= 2 && v.kind <= 4) {
+		std::size_t count = rng() % 5;
+		for (std::size_t i = 0; i < count; ++i) {
+			v.members.push_back(std::pair<std::string,Value>("k" + std::to_string(rng() % 20), random_value(rng, depth + 1)));
+		}
+	}
+	return v;
+}
+
+static void render(const Value& v, std::string& out) {
+	if (!v.alias.empty()) {
+		out += "&" + v.alias + " ";
+	}
+	switch (v.kind) {
+		case 0: out += std::to_string(v.n); break;
+		case 1: out += "\"s" + std::to_string(v.n) + "\""; break;
+		case 5: out += "*" + std::string(alias_names[v.n % 5]); break;
+		case 6: out += "@" + std::string(alias_names[v.n % 5]); break;
+		default: {
+			bool keyed = v.kind == 2 || (v.kind == 4 && v.n % 2 == 0);
+			out += v.kind == 2 ? "{" : v.kind == 3 ? "[" : "!T(";
+			for (std::size_t i = 0; i < v.members.size(); ++i) {
+				out += i ? (v.n % 3 ? ", " : ",\n\t") : "";
+				if (keyed) {
+					out += v.members[i].first + ": ";
+				}
+				render(v.members[i].second, out);
+			}
+			out += v.kind == 2 ? "}" : v.kind == 3 ? "]" : ")";
+		}
+	}
+}
+
+static void values(Value& v, std::vector<Value*>& all) {
+	all.push_back(&v);
+	for (std::size_t i = 0; i < v.members.size(); ++i) {
+		values(v.members[i].second, all);
+	}
+}
+
+// one random change to the model: a value replaced, a member added or
+// removed, or an anchor put on or taken off
+static void mutate(Value& root, std::mt19937& rng) {
+	std::vector<Value*> all;
+	values(root, all);
+	Value& v = *all[rng() % all.size()];
+	switch (rng() % 5) {
+		case 0:
+			if (&v != &root) {
+				v = random_value(rng, 2);
+				break;
+			}
+			// fall through
+		case 1:
+			if (v.kind >= 2 && v.kind <= 4) {
+				v.members.insert(v.members.begin() + rng() % (v.members.size() + 1),
+					std::pair<std::string,Value>("k" + std::to_string(rng() % 20), random_value(rng, 2)));
+			}
+			break;
+		case 2:
+			if (v.kind >= 2 && v.kind <= 4 && !v.members.empty()) {
+				v.members.erase(v.members.begin() + rng() % v.members.size());
+			}
+			break;
+		case 3:
+			if (v.kind < 5 && &v != &root) {
+				v.alias = v.alias.empty() ? alias_names[rng() % 5] : "";
+			}
+			break;
+		default:
+			v.n = (long long)(rng() % 1000);
+			break;
+	}
+}
+
+// every update gives the tree a fresh load of the same text gives, and an
+// update a fresh load refuses is refused too and changes nothing
+static void random_edits_match_fresh_loads() {
+	std::mt19937 rng(7);
+	int accepted = 0, refused = 0;
+	for (int round = 0; round < 20; ++round) {
+		Value model;
+		model.kind = 2;
+		model.n = 0;
+		for (int i = 0; i < 8; ++i) {
+			model.members.push_back(std::pair<std::string,Value>("m" + std::to_string(i), random_value(rng, 1)));
+		}
+		std::string text;
+		render(model, text);
+		while (!loads(text)) {
+			model.members.pop_back();
+			text.clear();
+			render(model, text);
+		}
+		Parser parser(text.data(), text.data() + text.size());
+		parser.set_incremental(true);
+		parser.get_document();
+		for (int step = 0; step < 60; ++step) {
+			Value next = model;
+			mutate(next, rng);
+			std::string edited;
+			render(next, edited);
+			if (rng() % 10 == 0) { // a stray character
+				edited.insert(edited.begin() + rng() % edited.size(), "{}[],:&*"[rng() % 8]);
+			}
+			bool valid = loads(edited), thrown = false;
+			try {
+				parser.update(edited.data(), edited.data() + edited.size());
+			} catch (std::exception&) {
+				thrown = true;
+			}
+			check(thrown != valid, "an update is refused exactly when a fresh load is");
+			if (valid) {
+				model = next;
+				text = edited;
+				++accepted;
+			} else {
+				++refused;
+			}
+			check(matches(parser, text), "an update against a fresh load");
+		}
+	}
+	check(accepted > 300 && refused > 100, "both kinds of edit were tried");
+}
+
+// the nodes updates replace are given back, so the memory of a document
+// edited over and over stays within a bound
+static void memory_stays_bounded() {
+	std::string text = "{list: [";
+	for (int i = 0; i < 500; ++i) {
+		text += (i ? ", " : "") + std::string("{name: \"item") + std::to_string(i) + "\", values: [1, 2, 3]}";
+	}
+	text += "], setting: 0}";
+	Parser parser(text.data(), text.data() + text.size());
+	parser.set_incremental(true);
+	parser.get_document();
+	std::size_t loaded = parser.document().allocated(), most = 0;
+	std::size_t at = text.find("setting: 0") + 9;
+	for (int i = 0; i < 5000; ++i) {
+		std::string value = std::to_string(i % 7);
+		parser.update(at, text.size() - 1 - at, value);
+		text.replace(at, text.size() - 1 - at, value);
+		std::size_t list = text.find("item") + 4;
+		parser.update(list, 1, std::to_string(i % 10));
+		text.replace(list, 1, std::to_string(i % 10));
+		if (parser.document().allocated() > most) {
+			most = parser.document().allocated();
+		}
+	}
+	check(most < 4 * loaded, "memory is bounded over many updates");
+	check(matches(parser, text), "the document after many updates");
+}
+
+int main() {
+	try {
+		lazy_and_threads_are_ignored();
+		accessors_follow_updates();
+		edits_inside_an_anchored_container();
+		edits_that_add_a_cycle();
+		edits_by_range();
+		random_edits_match_fresh_loads();
+		memory_stays_bounded();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
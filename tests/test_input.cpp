@@ -0,0 +1,98 @@
+// a document reads the same from a stream, a borrowed buffer, a file read
+// whole and a mapped file
+#include "../parser.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+// what print() writes for a node
+static std::string printed(Node& n) {
+	std::ostringstream out;
+	std::streambuf *old = std::cout.rdbuf(out.rdbuf());
+	try {
+		n.print(0);
+	} catch (...) {
+		std::cout.rdbuf(old);
+		throw;
+	}
+	std::cout.rdbuf(old);
+	return out.str();
+}
+
+static std::string sample() {
+	std::string text = "# a comment\n{name: \"dmon\", sizes: [1, 2, 3],\n\tnested: {flag: true, ratio: 0.5}, items: [";
+	// long enough to need several chunks of a stream
+	for (int i = 0; i < 20000; ++i) {
+		text += (i ? ", \"" : "\"") + std::to_string(i) + "\"";
+	}
+	return text + "]}\n";
+}
+
+static void sources_agree() {
+	std::string text = sample();
+	const char *file = "test_input.dmon";
+	{
+		std::ofstream out(file, std::ios_base::out | std::ios_base::binary);
+		out << text;
+	}
+	std::istringstream stream(text);
+	Parser from_stream(stream);
+	Parser borrowed(text.data(), text.data() + text.size());
+	Parser buffered(file, InputBuffer::Buffered);
+	Parser mapped(file, InputBuffer::Mapped);
+	std::string expected = printed(borrowed.get_document());
+	check(printed(from_stream.get_document()) == expected, "a stream");
+	check(printed(buffered.get_document()) == expected, "a file read whole");
+	check(printed(mapped.get_document()) == expected, "a mapped file");
+	std::string last;
+	mapped.get_document()["items"][19999] >> last;
+	check(last == "19999", "the last item of a mapped file");
+	std::remove(file);
+}
+
+static void buffers() {
+	std::string text = "[1, 2]";
+	std::istringstream stream(text);
+	InputBuffer from_stream(stream);
+	check(from_stream.mode() == InputBuffer::Buffered && from_stream.size() == text.size() &&
+		std::string(from_stream.begin(), from_stream.end()) == text, "a stream is buffered");
+	InputBuffer borrowed(text.data(), text.data() + text.size());
+	check(borrowed.mode() == InputBuffer::Borrowed && borrowed.begin() == text.data(), "a range is borrowed");
+	// an empty file cannot be mapped and is read instead
+	const char *file = "test_input_empty.dmon";
+	{
+		std::ofstream out(file);
+	}
+	InputBuffer empty(file, InputBuffer::Mapped);
+	check(empty.size() == 0, "an empty file");
+	std::remove(file);
+	bool thrown = false;
+	try {
+		InputBuffer missing("test_input_missing.dmon", InputBuffer::Mapped);
+	} catch (InputException&) {
+		thrown = true;
+	}
+	check(thrown, "a missing file");
+}
+
+int main() {
+	try {
+		sources_agree();
+		buffers();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
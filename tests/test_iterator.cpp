@@ -0,0 +1,74 @@
+// a Node::iterator walks the members of a map or sequence in place and
+// works with the standard algorithms
+#include "../parser.h"
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <iterator>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static int read_int(Node* n) {
+	int v;
+	*n >> v;
+	return v;
+}
+
+static void maps() {
+	std::string text = "{b: 2, a: 1, c: 3}";
+	Parser parser(text.data(), text.data() + text.size());
+	Node& root = parser.get_document();
+	std::string keys;
+	int sum = 0;
+	for (Node::iterator it = root.begin(); it != root.end(); ++it) {
+		keys += std::string(it.key());
+		sum += read_int(*it);
+	}
+	check(keys == "abc" && sum == 6, "the entries of a map");
+	check(root.end() - root.begin() == 3, "the distance across a map");
+}
+
+static void sequences() {
+	std::string text = "[5, 3, 9, 1, 7, &x [], *x, @x]";
+	Parser parser(text.data(), text.data() + text.size());
+	Node& root = parser.get_document();
+	Node::iterator first = root.begin(), last = root.begin() + 5;
+	check(last - first == 5 && first < last && last > first && first <= first && last >= first, "comparisons");
+	check(read_int(first[2]) == 9 && read_int(*(2 + first)) == 9 && read_int(*(last - 1)) == 7, "random access");
+	Node::iterator it = first;
+	check(read_int(*it++) == 5 && read_int(*it) == 3 && read_int(*--it) == 5, "increments and decrements");
+	check(it.key().empty(), "elements have no key");
+	Node::iterator most = std::max_element(first, last, [](Node* a, Node* b) {
+		return read_int(a) < read_int(b);
+	});
+	check(most - first == 2, "max_element");
+	check(std::distance(root.begin(), root.end()) == 8, "distance");
+	Node& empty = root[5];
+	check(empty.begin() == empty.end() && empty.size() == 0, "an empty sequence");
+	check(root[6].begin() == empty.begin() && root[7].end() == empty.end(), "through a reference and a link");
+	bool thrown = false;
+	try {
+		first[0]->begin();
+	} catch (NodeException&) {
+		thrown = true;
+	}
+	check(thrown, "a scalar has no members");
+}
+
+int main() {
+	try {
+		maps();
+		sequences();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
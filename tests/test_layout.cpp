@@ -0,0 +1,66 @@
+// a node is sixteen bytes whatever its type, and every type reads as it
+// did when each was a class of its own
+#include "../parser.h"
+#include <iostream>
+#include <string>
+#include <type_traits>
+
+static_assert(sizeof(Node) == 16, "a node is sixteen bytes");
+static_assert(!std::is_polymorphic<Node>::value, "a node has no virtual table");
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+int main() {
+	std::string text = "{s: \"text\", i: -7, f: 0.5, b: true, m: &m {k: 1}, q: [1, 2], "
+		"o: !O(k: 2), p: !P(3, 4), r: *m, l: @m, e: \"\"}";
+	try {
+		Parser parser(text.data(), text.data() + text.size());
+		Node& root = parser.get_document();
+		const char *keys[] = {"s", "i", "f", "b", "m", "q", "o", "p", "r", "l"};
+		bool typed = true;
+		for (int t = Node::String; t <= Node::Link; ++t) {
+			typed = typed && root[keys[t]].get_type() == (Node::NodeType)t;
+		}
+		check(typed, "every type");
+		std::string s;
+		long long i;
+		double f;
+		bool b;
+		root["s"] >> s;
+		root["i"] >> i;
+		root["f"] >> f;
+		root["b"] >> b;
+		check(s == "text" && i == -7 && f == 0.5 && b, "scalars in place");
+		root["e"] >> s;
+		check(s.empty(), "an empty string");
+		check(root["m"].size() == 1 && root["q"].size() == 2 && root["o"].size() == 1 && root["p"].size() == 2, "sizes");
+		check(root["o"].get_class_name() == "O" && root["p"].class_name() == "P" && root["m"].class_name().empty(), "class names");
+		check(root["r"].resolve() == &root["m"] && root["l"].resolve() == &root["m"] && root["r"].size() == 1, "references");
+		check(parser.document().created()[Node::Int] == 7 && parser.document().created()[Node::Map] == 2, "nodes created");
+		bool thrown = false;
+		try {
+			root["i"] >> s;
+		} catch (NodeException&) {
+			thrown = true;
+		}
+		check(thrown, "a type mismatch");
+		thrown = false;
+		try {
+			root["s"].size();
+		} catch (NodeException&) {
+			thrown = true;
+		}
+		check(thrown, "the size of a scalar");
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+// a lazy load reads as the full load does once its containers are reached;
+// grammar and alias errors are found when loading, others when reaching
+#include "../parser.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+// what print() writes for a node, which reaches every container
+static std::string printed(Node& n) {
+	std::ostringstream out;
+	std::streambuf *old = std::cout.rdbuf(out.rdbuf());
+	try {
+		n.print(0);
+	} catch (...) {
+		std::cout.rdbuf(old);
+		throw;
+	}
+	std::cout.rdbuf(old);
+	return out.str();
+}
+
+// the printed document, or the kind of error loading or reaching it threw
+static std::string load(const std::string& text, bool lazy, bool single_pass) {
+	Parser parser(text.data(), text.data() + text.size());
+	parser.set_lazy(lazy);
+	parser.set_single_pass(single_pass);
+	try {
+		return printed(parser.get_document());
+	} catch (LexException&) {
+		return "LexException";
+	} catch (ParseException&) {
+		return "ParseException";
+	} catch (ValidateException&) {
+		return "ValidateException";
+	}
+}
+
+static void equal_to_full_loads() {
+	const char *texts[] = {
+		"{a: 1, b: [2, 3.5, true, \"s\"], c: {d: {e: [[], {}]}}}",
+		"[&x {k: [1, 2]}, *x, @x, !P(x: *y, y: &y [3]), !Q(1, \"two\", !E())]",
+		"# comment\n{a: [1, # inner\n 2], b: \"x \\# y\"}",
+		"[1, 2",
+		"{a: [*missing]}",
+		"{a: &x [{b: *x}]}",
+		"{a: [1 2]}",
+		"{a: {b: 1, b: 2}}",
+	};
+	for (std::size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+		std::string full = load(texts[i], false, false);
+		check(load(texts[i], true, false) == full, std::string("lazy load of ") + texts[i] + ", expected " + full);
+		check(load(texts[i], true, true) == full, std::string("lazy single pass load of ") + texts[i] + ", expected " + full);
+	}
+}
+
+// only what is reached is built, and an error inside a container is
+// thrown by the access that reaches it
+static void built_on_access() {
+	std::string text = "{good: [1, 2], bad: {k: 1, k: 2}, anchored: &x [3], ref: *x}";
+	Parser parser(text.data(), text.data() + text.size());
+	parser.set_lazy(true);
+	Node& root = parser.get_document();
+	int n;
+	root["good"][1] >> n;
+	check(n == 2, "a member reached");
+	root["ref"][0] >> n;
+	check(n == 3, "a member reached through a reference");
+	bool thrown = false;
+	try {
+		root["bad"].size();
+	} catch (ParseException&) {
+		thrown = true;
+	}
+	check(thrown, "a duplicate key is thrown when its map is reached");
+}
+
+int main() {
+	try {
+		equal_to_full_loads();
+		built_on_access();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
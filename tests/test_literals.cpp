@@ -0,0 +1,96 @@
+// numbers and booleans are converted once, when loading, and refused then
+// when they do not fit
+#include "../parser.h"
+#include <iostream>
+#include <string>
+#include <climits>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static bool refused(const std::string& text) {
+	Parser parser(text.data(), text.data() + text.size());
+	try {
+		parser.get_document();
+	} catch (LexException&) {
+		return true;
+	} catch (ParseException&) {
+		return true;
+	}
+	return false;
+}
+
+static void conversions() {
+	std::string text = "[0, -12, +7, 010, 9223372036854775807, -9223372036854775808, 2147483648, "
+		"1.5, -0.25, 2e3, 1.5e-3, true, false]";
+	Parser parser(text.data(), text.data() + text.size());
+	Node& root = parser.get_document();
+	int i;
+	long long ll;
+	double x;
+	bool b;
+	root[0] >> i;
+	check(i == 0 && root[0].get_type() == Node::Int, "zero");
+	root[1] >> i;
+	check(i == -12, "a negative int");
+	root[2] >> i;
+	check(i == 7, "a signed int");
+	root[3] >> i;
+	check(i == 10, "a leading zero is decimal");
+	root[4] >> ll;
+	check(ll == LLONG_MAX, "the largest int");
+	root[5] >> ll;
+	check(ll == LLONG_MIN, "the smallest int");
+	root[6] >> ll;
+	check(ll == 2147483648LL, "an int past 32 bits");
+	bool thrown = false;
+	try {
+		root[6] >> i;
+	} catch (NodeException&) {
+		thrown = true;
+	}
+	check(thrown, "an int past 32 bits read into an int");
+	root[7] >> x;
+	check(x == 1.5 && root[7].get_type() == Node::Float, "a float");
+	root[8] >> x;
+	check(x == -0.25, "a negative float");
+	root[9] >> x;
+	check(x == 2000 && root[9].get_type() == Node::Float, "an exponent makes a float");
+	root[10] >> x;
+	check(x == 1.5e-3, "a negative exponent");
+	root[11] >> b;
+	check(b && root[11].get_type() == Node::Boolean, "true");
+	root[12] >> b;
+	check(!b, "false");
+	thrown = false;
+	try {
+		root[11] >> i;
+	} catch (NodeException&) {
+		thrown = true;
+	}
+	check(thrown, "a boolean read as an int");
+}
+
+static void errors() {
+	const char *bad[] = {"[9223372036854775808]", "[-9223372036854775809]", "[1e999]", "[+]", "[.]", "[1e]"};
+	for (std::size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+		check(refused(bad[i]), std::string("refused ") + bad[i]);
+	}
+}
+
+int main() {
+	try {
+		conversions();
+		errors();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
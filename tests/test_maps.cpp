@@ -0,0 +1,91 @@
+// maps find their keys whether they are scanned or indexed, and iterate in
+// key order or in the order the keys were written
+#include "../parser.h"
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static int read_int(Node& n) {
+	int v;
+	n >> v;
+	return v;
+}
+
+static void lookups() {
+	// a map of each size up to well past where it gets an index
+	for (int size = 0; size <= 40; ++size) {
+		std::string text = "{";
+		for (int i = 0; i < size; ++i) {
+			text += (i ? ", k" : "k") + std::to_string(i * 7919 % size) + ": " + std::to_string(i * 7919 % size);
+		}
+		text += "}";
+		Parser parser(text.data(), text.data() + text.size());
+		Node& root = parser.get_document();
+		bool found = root.size() == (Node::size_type)size;
+		for (int i = 0; i < size; ++i) {
+			std::string key = "k" + std::to_string(i);
+			found = found && root.find(key) == &root[key] && read_int(root[key]) == i;
+		}
+		check(found, "every key of a map of " + std::to_string(size));
+		check(!root.find("k") && !root.find("k" + std::to_string(size)) && !root.find(""), "missing keys of a map of " + std::to_string(size));
+		bool thrown = false;
+		try {
+			root["missing"];
+		} catch (NodeException&) {
+			thrown = true;
+		}
+		check(thrown, "indexing a missing key");
+	}
+}
+
+static std::string values(Node& map) {
+	std::string s;
+	for (Node::iterator it = map.begin(); it != map.end(); ++it) {
+		s += std::to_string(read_int(**it));
+	}
+	return s;
+}
+
+static void order() {
+	std::string text = "{c: 3, a: 1, e: 5, b: 2, d: 4}";
+	Parser sorted(text.data(), text.data() + text.size());
+	check(values(sorted.get_document()) == "12345", "sorted by key");
+	Parser kept(text.data(), text.data() + text.size());
+	kept.set_keep_key_order(true);
+	check(values(kept.get_document()) == "31524", "in the order written");
+	check(read_int(kept.get_document()["e"]) == 5, "a lookup in a map kept in order");
+}
+
+static void duplicates() {
+	const char *texts[] = {"{a: 1, a: 2}", "{a: 1, b: 2, c: 3, d: 4, e: 5, f: 6, g: 7, h: 8, i: 9, a: 10}", "!P(x: 1, x: 2)"};
+	for (std::size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+		Parser parser(texts[i], texts[i] + std::string(texts[i]).size());
+		bool thrown = false;
+		try {
+			parser.get_document();
+		} catch (std::runtime_error&) {
+			thrown = true;
+		}
+		check(thrown, std::string("a duplicate key in ") + texts[i]);
+	}
+}
+
+int main() {
+	try {
+		lookups();
+		order();
+		duplicates();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+// a load on several threads builds what a load on one builds, and refuses
+// what it refuses, wherever the parts are cut
+#include "../parser.h"
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static std::string emit(Document& doc) {
+	std::string out;
+	Emitter e(out);
+	e.write(doc);
+	e.flush();
+	return out;
+}
+
+// the emitted document, or the kind of error loading it threw
+static std::string load(const std::string& text, unsigned int threads, bool single_pass = false) {
+	Parser parser(text.data(), text.data() + text.size());
+	parser.set_threads(threads);
+	parser.set_single_pass(single_pass);
+	try {
+		parser.get_document();
+		return emit(parser.document());
+	} catch (LexException&) {
+		return "LexException";
+	} catch (ParseException&) {
+		return "ParseException";
+	} catch (ValidateException&) {
+		return "ValidateException";
+	}
+}
+
+// a top level map or sequence of n members large enough to be cut, with
+// aliases defined early and referred to late and the other way round
+static std::string large(int n, bool map, const std::string& last) {
+	std::string text = map ? "{" : "[";
+	for (int i = 0; i < n; ++i) {
+		text += i ? ",\n" : "";
+		if (map) {
+			text += "k" + std::to_string(i) + ": ";
+		}
+		if (i == 10) {
+			text += "&early {name: \"early\", late: *late}";
+		} else if (i == n - 10) {
+			text += "&late [1, 2, 3]";
+		} else if (i % 100 == 0) {
+			text += "[*early, @late, !P(x: " + std::to_string(i) + ")]";
+		} else {
+			text += "{id: " + std::to_string(i) + ", tags: [\"a\", \"b\"], ratio: 0." + std::to_string(i) + "}";
+		}
+	}
+	return text + last + (map ? "}" : "]");
+}
+
+int main() {
+	struct {
+		const char *what;
+		std::string text;
+	} cases[] = {
+		{"a map", large(20000, true, "")},
+		{"a sequence", large(20000, false, "")},
+		{"a duplicate key in another part", large(20000, true, ",\nk5: 1")},
+		{"an unknown alias", large(20000, false, ",\n*nowhere")},
+		{"a cycle across parts", large(20000, false, ",\n&loop [*early, *loop]")},
+		{"a grammar error in the last part", large(20000, false, ",\n{a 1}")},
+		{"a small document", "{a: [1, 2], b: {c: 3}}"},
+	};
+	try {
+		for (std::size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+			std::string one = load(cases[i].text, 1);
+			check(load(cases[i].text, 4) == one, std::string(cases[i].what) + " on four threads");
+			check(load(cases[i].text, 0) == one, std::string(cases[i].what) + " on a thread per core");
+			check(load(cases[i].text, 3, true) == one, std::string(cases[i].what) + " in a single pass on three threads");
+		}
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
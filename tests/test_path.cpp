@@ -0,0 +1,137 @@
+// paths compile from their expressions or say where they are wrong, and
+// reach the same nodes a walk by hand does
+#include "../parser.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static std::string describe(const Path& p) {
+	static const char *kinds[] = {"key", "index", "every", "class"};
+	std::string s;
+	for (std::size_t i = 0; i < p.steps().size(); ++i) {
+		const Path::Step& step = p.steps()[i];
+		s += std::string(i ? " " : "") + kinds[step.kind];
+		s += step.kind == Path::Step::Index ? ":" + std::to_string(step.index) : step.name.empty() ? "" : ":" + step.name;
+	}
+	return s;
+}
+
+static void parsing() {
+	struct {
+		const char *expression, *steps;
+	} good[] = {
+		{"", ""},
+		{"a", "key:a"},
+		{"servers[3].ports[0]", "key:servers index:3 key:ports index:0"},
+		{"servers.*!Server.name", "key:servers every class:Server key:name"},
+		{"[*].x", "every key:x"},
+		{"[0][1]", "index:0 index:1"},
+		{"*", "every"},
+		{"!P", "class:P"},
+		{"a_1.B2[4294967295]", "key:a_1 key:B2 index:4294967295"},
+	};
+	for (std::size_t i = 0; i < sizeof(good) / sizeof(good[0]); ++i) {
+		std::string got = describe(Path(good[i].expression));
+		check(got == good[i].steps, std::string("steps of ") + good[i].expression + ": " + got);
+	}
+	struct {
+		const char *expression, *error;
+	} bad[] = {
+		{".", "expected a name at 1"},
+		{"a.", "expected a name at 2"},
+		{"a..b", "expected a name at 2"},
+		{"a[", "expected an index at 2"},
+		{"a[]", "expected an index at 2"},
+		{"a[1", "expected ] at 3"},
+		{"a[x]", "expected an index at 2"},
+		{"a[4294967296]", "index out of range at 1"},
+		{"a b", "unexpected character at 1"},
+		{"!", "expected a name at 1"},
+		{"a-b", "unexpected character at 1"},
+	};
+	for (std::size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+		std::string error;
+		try {
+			Path p(bad[i].expression);
+		} catch (PathException& e) {
+			error = e.what();
+		}
+		check(error.find(bad[i].error) != std::string::npos, std::string("error of ") + bad[i].expression + ": " + error);
+	}
+}
+
+static const char *text = "{servers: [!Server(name: \"a\", ports: [80, 443]), !Proxy(name: \"p\"), "
+	"&b !Server(name: \"b\", ports: [22])], backup: *b, list: [*b, @b]}";
+
+static std::string names(Node& root, const char* expression) {
+	std::string s;
+	Path(expression).each(root, [&s](Node* n) {
+		std::string name;
+		*n >> name;
+		s += name;
+		return true;
+	});
+	return s;
+}
+
+static void walking() {
+	Parser parser(text, text + std::string(text).size());
+	Node& root = parser.get_document();
+	check(names(root, "servers.*.name") == "apb", "every name");
+	check(names(root, "servers[*]!Server.name") == "ab", "the names of one class");
+	check(names(root, "backup.name") == "b" && names(root, "list.*.name") == "bb", "through references and links");
+	check(Path("servers[1].ports").find(root) == 0 && Path("servers[9]").find(root) == 0 && Path("servers.x").find(root) == 0,
+		"steps that do not apply");
+	check(Path("servers[2].ports[0]").find(root) == &root["servers"][2]["ports"][0], "a node found");
+	int port;
+	Accessor ports("servers.*.ports[1]", root);
+	ports >> port;
+	check(port == 443 && ports.all().size() == 1 && ports.get() == &*ports, "an accessor");
+	Accessor none("servers[7]", root);
+	bool thrown = false;
+	try {
+		*none;
+	} catch (NodeException&) {
+		thrown = true;
+	}
+	check(!none.get() && none.all().empty() && thrown, "an accessor that reaches nothing");
+}
+
+// an accessor may be made for a document before it is loaded; it is an
+// error to use it before then
+static void unloaded() {
+	Parser parser(text, text + std::string(text).size());
+	Accessor name("backup.name", parser.document());
+	bool thrown = false;
+	try {
+		name.get();
+	} catch (PathException&) {
+		thrown = true;
+	}
+	check(thrown, "an accessor of a document not yet loaded");
+	parser.get_document();
+	std::string s;
+	name >> s;
+	check(s == "b", "the same accessor once the document is loaded");
+}
+
+int main() {
+	try {
+		parsing();
+		walking();
+		unloaded();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
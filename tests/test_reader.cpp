@@ -0,0 +1,109 @@
+// the events a Reader pulls, and what skip() passes over
+#include "../parser.h"
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static const char *kinds[] = {"map", "seq", "object", "key", "scalar", "alias", "ref", "link", "end"};
+
+static std::string describe(const Reader::Event& e) {
+	std::string s = kinds[e.kind];
+	if (e.kind == Reader::Event::Scalar) {
+		s += "." + std::to_string(e.type);
+	}
+	if (!e.text.empty()) {
+		s += ":" + e.text;
+	}
+	return s;
+}
+
+// every event of the text, separated by spaces
+static std::string events(const std::string& text) {
+	Reader reader(text.data(), text.data() + text.size());
+	Reader::Event e;
+	std::string out;
+	while (reader.next(e)) {
+		out += (out.empty() ? "" : " ") + describe(e);
+	}
+	return out;
+}
+
+static void stream() {
+	std::string got = events("{a: 1, b: [2.5, true, \"s\\\"q\\#\"], c: !P(x: &n 3), d: *n, e: @n}");
+	check(got == "map key:a scalar.1:1 key:b seq scalar.2:2.5 scalar.3:true scalar.0:s\"q# end "
+		"key:c object:P key:x alias:n scalar.1:3 end key:d ref:n key:e link:n end", "events of a map: " + got);
+	got = events("[&s !Q(1, \"x\"), []]");
+	check(got == "seq alias:s object:Q scalar.1:1 scalar.0:x end seq end end", "events of a sequence: " + got);
+	got = events("# only a comment\n\"s\"");
+	check(got == "scalar.0:s", "a document that is a scalar: " + got);
+}
+
+static void lines() {
+	std::string text = "{\n\ta: 1,\n\n\tb: \"x\"\n}";
+	Reader reader(text.data(), text.data() + text.size());
+	Reader::Event e;
+	unsigned int found[6] = {0};
+	for (int i = 0; i < 6 && reader.next(e); ++i) {
+		found[i] = e.line;
+	}
+	check(found[1] == 2 && found[2] == 2 && found[3] == 4 && found[4] == 4 && found[5] == 5, "line numbers of events");
+}
+
+// skip() passes over the rest of the container whose start was just read,
+// whatever it holds, and leaves the reader at the event after it
+static void skipping() {
+	std::string text = "{a: [1, {b: [2, 3]}, !P(c: 4)], d: {e: 5}, f: 6}";
+	Reader reader(text.data(), text.data() + text.size());
+	Reader::Event e;
+	reader.next(e);
+	reader.next(e);
+	check(reader.next(e) && e.kind == Reader::Event::BeginSeq && reader.depth() == 2, "at the first member");
+	reader.skip();
+	check(reader.depth() == 1, "depth after a skip");
+	check(reader.next(e) && e.kind == Reader::Event::Key && e.text == "d", "the key after a skipped container");
+	check(reader.next(e) && e.kind == Reader::Event::BeginMap, "the next container");
+	reader.skip();
+	check(reader.next(e) && e.kind == Reader::Event::Key && e.text == "f", "the key after a second skip");
+	check(reader.next(e) && e.kind == Reader::Event::Scalar && e.text == "6", "the last value");
+	check(reader.next(e) && e.kind == Reader::Event::End, "the end of the map");
+	check(!reader.next(e), "the end of the document");
+}
+
+static bool refused(const std::string& text) {
+	try {
+		events(text);
+	} catch (LexException&) {
+		return true;
+	} catch (ParseException&) {
+		return true;
+	}
+	return false;
+}
+
+static void errors() {
+	check(refused("[1, 2"), "an unclosed sequence");
+	check(refused("{a 1}"), "a missing colon");
+	check(refused("{a: 1, b}"), "a key without a value");
+	check(refused("[&a *b]"), "an aliased reference");
+}
+
+int main() {
+	try {
+		stream();
+		lines();
+		skipping();
+		errors();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
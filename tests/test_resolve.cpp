@@ -0,0 +1,59 @@
+// references and links point straight at the value their alias names, and
+// read through to it
+#include "../parser.h"
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static void resolved() {
+	std::string text = "{a: &x {n: 1, s: [\"one\"]}, b: *x, c: [@x, *y], d: &y \"d\"}";
+	for (int single_pass = 0; single_pass < 2; ++single_pass) {
+		Parser parser(text.data(), text.data() + text.size());
+		parser.set_single_pass(single_pass != 0);
+		Node& root = parser.get_document();
+		Node *a = &root["a"];
+		check(root["b"].get_type() == Node::Reference && root["b"].resolve() == a, "a reference");
+		check(root["c"][0].get_type() == Node::Link && root["c"][0].resolve() == a, "a link");
+		check(root["c"][1].resolve() == &root["d"], "a reference to a value defined after it");
+		check(&parser.document().get_anchor("x") == a, "the anchor");
+		check(a->resolve() == a, "a value resolves to itself");
+		int n;
+		root["b"]["n"] >> n;
+		std::string s;
+		root["c"][0]["s"][0] >> s;
+		check(n == 1 && s == "one" && root["b"].size() == 2, "reading through a reference");
+		root["c"][1] >> s;
+		check(s == "d", "reading a scalar through a reference");
+	}
+}
+
+static void unknown() {
+	std::string text = "{a: &x 1, b: *y}";
+	Parser parser(text.data(), text.data() + text.size());
+	bool thrown = false;
+	try {
+		parser.get_document();
+	} catch (ValidateException& e) {
+		thrown = std::string(e.what()).find("unknown alias: y") != std::string::npos;
+	}
+	check(thrown, "an unknown alias");
+}
+
+int main() {
+	try {
+		resolved();
+		unknown();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+// a single pass load builds what the two pass load builds, and refuses what
+// it refuses
+#include "../parser.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+// what print() writes for a node
+static std::string printed(Node& n) {
+	std::ostringstream out;
+	std::streambuf *old = std::cout.rdbuf(out.rdbuf());
+	try {
+		n.print(0);
+	} catch (...) {
+		std::cout.rdbuf(old);
+		throw;
+	}
+	std::cout.rdbuf(old);
+	return out.str();
+}
+
+// the printed document, or the kind of error loading it threw
+static std::string load(const std::string& text, bool single_pass) {
+	Parser parser(text.data(), text.data() + text.size());
+	parser.set_single_pass(single_pass);
+	try {
+		return printed(parser.get_document());
+	} catch (LexException&) {
+		return "LexException";
+	} catch (ParseException&) {
+		return "ParseException";
+	} catch (ValidateException&) {
+		return "ValidateException";
+	}
+}
+
+int main() {
+	const char *texts[] = {
+		"{a: 1, b: [2, 3.5, true, \"s\\n\"], c: {d: false}}",
+		"[]",
+		"{}",
+		"!Point(x: 1, y: 2)",
+		"!Pair(1, \"two\")",
+		"!Empty()",
+		"# a comment\n[1, # another\n 2]",
+		"{a: &x [1, 2], b: *x, c: @x}",
+		"[&first {k: \"v\"}, *first]",
+		"{a: 1, a: 2}",
+		"{a: 1,}",
+		"[1, 2",
+		"{a: }",
+		"[*missing]",
+		"{a: &x [*x]}",
+		"{a: &r *r}",
+		"\"unterminated",
+		"[1 2]",
+		"{1: 2}",
+	};
+	for (std::size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+		std::string two_pass = load(texts[i], false);
+		check(load(texts[i], true) == two_pass, std::string("single pass of ") + texts[i] + ", expected " + two_pass);
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,75 @@
+// the statistics count what loading found, the same way in every mode
+#include "../parser.h"
+#include <iostream>
+#include <string>
+#include <map>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static const std::string text = "{a: &x [1, 2.5], b: *x, c: @x, d: !P(s: \"t\", f: true, g: [[{}]])}";
+
+static void counts(const char* mode, const Parser::Stats& s) {
+	std::string m = std::string(" in ") + mode;
+	check(s.bytes == text.size(), "bytes" + m);
+	check(s.tokens[TOK_CBRACE_L] == 2 && s.tokens[TOK_SBRACE_L] == 3 && s.tokens[TOK_RBRACE_L] == 1, "brackets" + m);
+	check(s.tokens[TOK_COLON] == 7 && s.tokens[TOK_COMMA] == 6 && s.tokens[TOK_IDENTIFIER] == 11, "separators and names" + m);
+	check(s.tokens[TOK_INT] == 1 && s.tokens[TOK_FLOAT] == 1 && s.tokens[TOK_STRING] == 1 && s.tokens[TOK_BOOL] == 1, "literals" + m);
+	check(s.tokens[TOK_AMPERSAND] == 1 && s.tokens[TOK_ASTERISK] == 1 && s.tokens[TOK_AT] == 1 && s.tokens[TOK_BANG] == 1, "sigils" + m);
+	check(s.nodes[Node::Map] == 2 && s.nodes[Node::Sequence] == 3 && s.nodes[Node::ObjMap] == 1, "containers" + m);
+	check(s.nodes[Node::Int] == 1 && s.nodes[Node::Float] == 1 && s.nodes[Node::String] == 1 && s.nodes[Node::Boolean] == 1,
+		"scalars" + m);
+	check(s.nodes[Node::Reference] == 1 && s.nodes[Node::Link] == 1 && s.references == 1 && s.links == 1, "references" + m);
+	check(s.aliases == 1 && s.depth == 5 && s.allocated > 0, "aliases, depth and memory" + m);
+}
+
+static void modes() {
+	for (int mode = 0; mode < 3; ++mode) {
+		Parser parser(text.data(), text.data() + text.size());
+		parser.set_single_pass(mode == 1);
+		parser.set_threads(mode == 2 ? 2 : 1);
+		parser.get_document();
+		counts(mode == 0 ? "two passes" : mode == 1 ? "one pass" : "threads", parser.stats());
+	}
+	// a lazy load counts the nodes built so far
+	Parser lazy(text.data(), text.data() + text.size());
+	lazy.set_lazy(true);
+	Node& root = lazy.get_document();
+	std::size_t before = lazy.stats().nodes[Node::Int];
+	int n;
+	root["a"][0] >> n;
+	check(before == 0 && lazy.stats().nodes[Node::Int] == 1, "the nodes of a lazy load");
+}
+
+static void timings() {
+	Parser parser(text.data(), text.data() + text.size());
+	parser.get_document();
+	std::map<std::string,double> reported;
+	parser.stats().report([&reported](const std::string& name, double value) {
+		reported[name] = value;
+	});
+	check(reported["bytes"] == text.size() && reported["tokens.COLON"] == 7 && reported["nodes.Map"] == 2, "reported counts");
+	check(reported.count("seconds.lex") && reported.count("seconds.interpret"), "reported phases");
+	bool timed = !parser.stats().seconds.empty();
+	for (std::size_t i = 0; i < parser.stats().seconds.size(); ++i) {
+		timed = timed && parser.stats().seconds[i].second >= 0;
+	}
+	check(timed, "phase timings");
+}
+
+int main() {
+	try {
+		modes();
+		timings();
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
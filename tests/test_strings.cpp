@@ -0,0 +1,43 @@
+// keys, class names and alias names are kept once per document, however
+// often they are written
+#include "../parser.h"
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+int main() {
+	std::string text = "[";
+	for (int i = 0; i < 1000; ++i) {
+		text += (i ? ", " : "") + std::string("!Point(x: ") + std::to_string(i) + ", y: {name: \"p\", size: 1})";
+	}
+	text += ", &last {x: 0}, *last]";
+	try {
+		Parser parser(text.data(), text.data() + text.size());
+		Node& root = parser.get_document();
+		StringPool& pool = parser.strings();
+		// Point, x, y, name, size and last
+		check(pool.size() == 6, "each name once");
+		std::string_view x = pool.find("x");
+		check(x == "x" && pool.intern("x").data() == x.data(), "a name is interned once");
+		check(!pool.find("z").data(), "a name never written");
+		check(root[0].find_interned(x) == &root[0]["x"] && root[999].find_interned(x) == &root[999]["x"],
+			"a lookup by interned name");
+		check(root[1000].find_interned(x) == &root[1000]["x"], "a lookup in a plain map");
+		check(!root[0].find("z") && root[0].find("y") == &root[0]["y"], "a lookup by any string");
+		check(root[0].get_class_name() == "Point" && root[1001].resolve() == &root[1000], "class and alias names");
+		std::string key("size");
+		check(root[10]["y"].find(key) == &root[10]["y"]["size"], "a key the caller built");
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+// the runs the structural index finds are those a byte at a time scan
+// finds. the test is built once with the library and again from
+// structural.cpp alone with each instruction set left out, so the AVX2,
+// SSE2 and scalar classifiers are each held to the same answers
+#include "../parser.h"
+#include <iostream>
+#include <string>
+#include <random>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+static bool is_space(char c) {
+	return c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r' || c == ' ';
+}
+
+static bool is_word(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static bool is_stop(char c) {
+	return c == '"' || c == '\\' || c == '#';
+}
+
+// the first byte from p on for which stops is true, counting the lines passed
+static const char* scan(const char* p, const char* end, bool (*stops)(char), unsigned int& lines) {
+	for (; p != end && !stops(p[0]); ++p) {
+		lines += p[0] == '\n';
+	}
+	return p;
+}
+
+static bool not_space(char c) {return !is_space(c);}
+static bool not_word(char c) {return !is_word(c);}
+
+static void runs(std::mt19937& rng, std::size_t size) {
+	static const char alphabet[] = " \t\n\r\v\f\"\\#_aZz09{}[]():,.-+&*@!\x80\xff\x01\x7f";
+	std::string text(size, ' ');
+	// runs of one class, so that they cross block boundaries
+	for (std::size_t i = 0; i < size;) {
+		char c = alphabet[rng() % (sizeof(alphabet) - 1)];
+		for (std::size_t n = rng() % 4 == 0 ? rng() % 150 : 1; n > 0 && i < size; --n, ++i) {
+			text[i] = rng() % 8 ? c : alphabet[rng() % (sizeof(alphabet) - 1)];
+		}
+	}
+	const char *begin = text.data(), *end = begin + size;
+	StructuralIndex index(end);
+	bool agree = true;
+	// mostly forward, as the lexer goes, with jumps both ways
+	for (int step = 0; step < 2000 && size; ++step) {
+		const char *p = begin + rng() % size;
+		for (int k = 0; k < 20 && p < end; ++k) {
+			unsigned int lines = 0, expected_lines = 0;
+			const char *got, *expected;
+			switch (rng() % 3) {
+				case 0:
+					got = index.skip_space(p, lines);
+					expected = scan(p, end, not_space, expected_lines);
+					break;
+				case 1:
+					got = index.skip_word(p);
+					expected = scan(p, end, not_word, expected_lines);
+					break;
+				default:
+					got = index.find_stop(p, lines);
+					expected = scan(p, end, is_stop, expected_lines);
+					break;
+			}
+			agree = agree && got == expected && lines == expected_lines;
+			p = got + 1;
+		}
+	}
+	check(agree, "runs in a text of " + std::to_string(size) + " bytes with the " + StructuralIndex::level() + " classifier");
+}
+
+int main() {
+#if defined(DMON_NO_SIMD)
+	check(std::string(StructuralIndex::level()) == "scalar", "the scalar classifier");
+#elif defined(DMON_NO_AVX2) && (defined(__SSE2__) || defined(_M_X64))
+	check(std::string(StructuralIndex::level()) == "sse2", "the SSE2 classifier");
+#endif
+	std::mt19937 rng(18);
+	const std::size_t sizes[] = {0, 1, 63, 64, 65, 127, 128, 1000, 4096, 100003};
+	for (std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		runs(rng, sizes[i]);
+	}
+	return failures ? 1 : 0;
+}
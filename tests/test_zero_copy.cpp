@@ -0,0 +1,58 @@
+// with zero copy, names and plain strings are views of the input; strings
+// with escapes or comments are still built, and the values read the same
+#include "../parser.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+	if (!ok) {
+		std::cerr << "failed: " << what << std::endl;
+		++failures;
+	}
+}
+
+// what print() writes for a node
+static std::string printed(Node& n) {
+	std::ostringstream out;
+	std::streambuf *old = std::cout.rdbuf(out.rdbuf());
+	try {
+		n.print(0);
+	} catch (...) {
+		std::cout.rdbuf(old);
+		throw;
+	}
+	std::cout.rdbuf(old);
+	return out.str();
+}
+
+int main() {
+	std::string text = "{plain: \"abc\", escaped: \"a\\\"b\", commented: \"a # a comment\n b \\# kept\", "
+		"obj: !Name(key: &alias \"v\"), other: *alias, last: [\"x\", \"y\"]}";
+	try {
+		Parser copied(text.data(), text.data() + text.size());
+		Parser viewed(text.data(), text.data() + text.size());
+		viewed.set_zero_copy(true);
+		Node& root = viewed.get_document();
+		check(printed(root) == printed(copied.get_document()), "the same document either way");
+		std::string_view key = viewed.strings().find("plain");
+		check(key.data() >= text.data() && key.data() < text.data() + text.size(), "a name is a view of the input");
+		key = copied.strings().find("plain");
+		check(key.data() < text.data() || key.data() >= text.data() + text.size(), "a name is copied by default");
+		std::string s;
+		root["escaped"] >> s;
+		check(s == "a\"b", "an escaped string");
+		root["commented"] >> s;
+		check(s == "a  b # kept", "a string with a comment and an escaped #");
+		root["other"] >> s;
+		check(s == "v", "a string read through a reference");
+		root["last"][1] >> s;
+		check(s == "y", "a string in a sequence");
+	} catch (std::exception& e) {
+		std::cerr << "failed: " << e.what() << std::endl;
+		++failures;
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,416 @@
+// measures each stage of loading generated dmon corpora. the corpora are
+// built from a fixed seed, so every run on every machine sees the same
+// bytes; the results are one tab separated line per corpus and stage, to
+// be compared across commits with diff or any table tool.
+//
+//   dmonbench [-s size] [-r runs] [-w dir] [corpus...]
+//
+//   -s  approximate size of each corpus in bytes, with an optional k or m
+//       suffix; 4m by default
+//   -r  runs of each stage, of which the fastest is reported; 5 by default
+//   -w  also write each corpus to dir/<corpus>.dmon
+//
+// the corpora are nested, wide, strings, comments, aliases and numbers, all
+// of them by default. the stages are the phases of a two pass load (lex,
+// parse, interpret, cycles, resolve), a whole single pass load (single),
+// pulling every event through a Reader (reader) and writing the loaded
+// document back out as text (emit). the columns are
+//
+//   corpus stage bytes nodes seconds mb_per_s nodes_per_s allocs alloc_bytes
+//
+// where allocs and alloc_bytes count the calls to operator new made during
+// the stage, arena blocks included.
+//
+// built with the top level CMakeLists.txt, or by hand from the library
+// sources, e.g.
+//   c++ -std=c++17 -O2 -I.. ../*.cpp dmonbench.cpp -o dmonbench
+
+#include "../parser.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+
+// every allocation of the process goes through these; the benchmark runs
+// on one thread, so plain counters are enough
+static std::size_t allocs = 0, alloc_bytes = 0;
+
+static void* counted(std::size_t n) {
+	++allocs;
+	alloc_bytes += n;
+	void *p = std::malloc(n ? n : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+static void* counted(std::size_t n, std::align_val_t a) {
+	++allocs;
+	alloc_bytes += n;
+	std::size_t align = (std::size_t)a;
+	void *p = std::aligned_alloc(align, (n + align - 1) / align * align);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new(std::size_t n) {return counted(n);}
+void* operator new[](std::size_t n) {return counted(n);}
+void* operator new(std::size_t n, std::align_val_t a) {return counted(n, a);}
+void* operator new[](std::size_t n, std::align_val_t a) {return counted(n, a);}
+void operator delete(void* p) noexcept {std::free(p);}
+void operator delete[](void* p) noexcept {std::free(p);}
+void operator delete(void* p, std::size_t) noexcept {std::free(p);}
+void operator delete[](void* p, std::size_t) noexcept {std::free(p);}
+void operator delete(void* p, std::align_val_t) noexcept {std::free(p);}
+void operator delete[](void* p, std::align_val_t) noexcept {std::free(p);}
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {std::free(p);}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {std::free(p);}
+
+// splitmix64, whose output is the same everywhere, unlike the standard
+// distributions
+class Random {
+	std::uint64_t _state;
+public:
+	Random(std::uint64_t seed): _state(seed) {}
+	std::uint64_t next() {
+		std::uint64_t z = (_state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+	unsigned int below(unsigned int n) {return (unsigned int)(next() % n);}
+};
+
+static void scalar(std::string& out, Random& r) {
+	switch (r.below(4)) {
+		case 0: out += std::to_string((long long)r.below(2000000) - 1000000); break;
+		case 1: out += std::to_string(r.below(100000)) + "." + std::to_string(r.below(1000)); break;
+		case 2: out += r.below(2) ? "true" : "false"; break;
+		default: out += "\"s" + std::to_string(r.below(100000)) + "\""; break;
+	}
+}
+
+// chains of maps, sequences and objects a few hundred levels deep
+static void nested_value(std::string& out, Random& r, unsigned int depth) {
+	if (depth == 0) {
+		scalar(out, r);
+		return;
+	}
+	switch (r.below(3)) {
+		case 0:
+			out += "{k: ";
+			nested_value(out, r, depth - 1);
+			out += ", v: ";
+			scalar(out, r);
+			out += "}";
+			break;
+		case 1:
+			out += "[";
+			scalar(out, r);
+			out += ", ";
+			nested_value(out, r, depth - 1);
+			out += "]";
+			break;
+		default:
+			out += "!Node(";
+			nested_value(out, r, depth - 1);
+			out += ")";
+			break;
+	}
+}
+
+static void nested(std::string& out, Random& r, std::size_t size) {
+	out += "[\n";
+	while (out.size() < size) {
+		nested_value(out, r, 200 + r.below(200));
+		out += ",\n";
+	}
+	out += "0]\n";
+}
+
+// maps of ten thousand keys each
+static void wide(std::string& out, Random& r, std::size_t size) {
+	out += "{\n";
+	for (unsigned int m = 0; out.size() < size; ++m) {
+		out += "m" + std::to_string(m) + ": {";
+		for (unsigned int k = 0; k < 10000; ++k) {
+			out += (k ? ", key" : "key") + std::to_string(k) + ": ";
+			scalar(out, r);
+		}
+		out += "},\n";
+	}
+	out += "end: 0}\n";
+}
+
+// long strings with escaped quotes, backslashes and comment signs
+static void strings(std::string& out, Random& r, std::size_t size) {
+	static const char* pieces[] = {"lorem ipsum ", "dolor sit amet ", "\\\"quoted\\\" ", "back\\\\slash ", "\\# not a comment ", "tab\there "};
+	out += "[\n";
+	while (out.size() < size) {
+		out += "\"";
+		for (unsigned int n = 200 + r.below(2000); n > 0; --n) {
+			out += pieces[r.below(6)];
+		}
+		out += "\",\n";
+	}
+	out += "\"\"]\n";
+}
+
+// more comment than content
+static void comments(std::string& out, Random& r, std::size_t size) {
+	out += "# generated\n{\n";
+	for (unsigned int k = 0; out.size() < size; ++k) {
+		for (unsigned int n = 1 + r.below(4); n > 0; --n) {
+			out += "# a comment line about key" + std::to_string(k) + ", with some padding to make it long\n";
+		}
+		out += "key" + std::to_string(k) + ": ";
+		scalar(out, r);
+		out += ", # trailing\n";
+	}
+	out += "end: 0}\n";
+}
+
+// anchored values full of references and links to earlier anchors, so the
+// cycle check has long chains of edges to follow
+static void aliases(std::string& out, Random& r, std::size_t size) {
+	out += "[\n";
+	unsigned int a = 0;
+	for (; out.size() < size; ++a) {
+		out += "&a" + std::to_string(a) + " {v: ";
+		scalar(out, r);
+		for (unsigned int n = a ? r.below(8) : 0; n > 0; --n) {
+			unsigned int to = a - 1 - r.below(a < 16 ? a : 16);
+			out += ", r" + std::to_string(n) + (r.below(2) ? ": *a" : ": @a") + std::to_string(to);
+		}
+		out += "},\n";
+	}
+	out += "*a" + std::to_string(a - 1) + "]\n";
+}
+
+// sequences of integers and floats, exponents and signs included
+static void numbers(std::string& out, Random& r, std::size_t size) {
+	out += "[\n";
+	while (out.size() < size) {
+		out += "[";
+		for (unsigned int n = 0; n < 1000; ++n) {
+			if (n) {
+				out += ", ";
+			}
+			switch (r.below(3)) {
+				case 0: out += std::to_string((long long)(r.next() >> 2) - (long long)(r.next() >> 2)); break;
+				case 1: out += "-" + std::to_string(r.below(1000)) + "." + std::to_string(r.below(1000000)); break;
+				default: out += std::to_string(r.below(10)) + "." + std::to_string(r.below(1000)) + "e" + std::to_string((int)r.below(600) - 300); break;
+			}
+		}
+		out += "],\n";
+	}
+	out += "[]]\n";
+}
+
+struct Corpus {
+	const char *name;
+	void (*generate)(std::string&, Random&, std::size_t);
+};
+
+static const Corpus corpora[] = {
+	{"nested", nested}, {"wide", wide}, {"strings", strings},
+	{"comments", comments}, {"aliases", aliases}, {"numbers", numbers}
+};
+
+struct Measure {
+	double seconds;
+	std::size_t allocs, alloc_bytes;
+};
+
+static std::size_t count_nodes(Node* n) {
+	std::size_t count = 1;
+	Node::NodeType t = n->get_type();
+	if (t == Node::Map || t == Node::Sequence || t == Node::ObjMap || t == Node::ObjSequence) {
+		for (Node::iterator it = n->begin(); it != n->end(); ++it) {
+			count += count_nodes(*it);
+		}
+	}
+	return count;
+}
+
+static double now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// keeps the fastest run of each stage
+static void keep(Measure& best, const Measure& m) {
+	if (best.seconds < 0 || m.seconds < best.seconds) {
+		best = m;
+	}
+}
+
+static void report(const char* corpus, const char* stage, std::size_t bytes, std::size_t nodes, const Measure& m) {
+	char line[256];
+	double s = m.seconds > 0 ? m.seconds : 1e-9;
+	std::snprintf(line, sizeof(line), "%s\t%s\t%zu\t%zu\t%.6f\t%.2f\t%.0f\t%zu\t%zu",
+		corpus, stage, bytes, nodes, m.seconds, bytes / s / 1e6, nodes / s, m.allocs, m.alloc_bytes);
+	std::cout << line << std::endl;
+}
+
+static const char* phases[] = {"lex", "parse", "interpret", "cycles", "resolve"};
+static const int phase_count = sizeof(phases) / sizeof(*phases);
+
+static void bench(const Corpus& corpus, const std::string& text, int runs) {
+	const char *begin = text.data(), *end = begin + text.size();
+	std::size_t nodes;
+	{
+		Parser parser(begin, end);
+		parser.set_single_pass(true);
+		parser.get_document();
+		nodes = count_nodes(&parser.document().root());
+	}
+	Measure best[phase_count + 3];
+	for (int i = 0; i < phase_count + 3; ++i) {
+		best[i].seconds = -1;
+	}
+	for (int run = 0; run < runs; ++run) {
+		// the phases of a two pass load, split where each reports its time
+		{
+			Measure m[phase_count] = {};
+			std::size_t a = allocs, b = alloc_bytes;
+			Parser parser(begin, end);
+			parser.set_diagnostics(Diagnostics::Info, [&](const Diagnostics::Record& r) {
+				for (int i = 0; i < phase_count; ++i) {
+					if (r.phase && std::strcmp(r.phase, phases[i]) == 0) {
+						m[i].seconds += r.seconds;
+						m[i].allocs += allocs - a;
+						m[i].alloc_bytes += alloc_bytes - b;
+					}
+				}
+				a = allocs;
+				b = alloc_bytes;
+			});
+			parser.get_document();
+			for (int i = 0; i < phase_count; ++i) {
+				keep(best[i], m[i]);
+			}
+		}
+		{
+			std::size_t a = allocs, b = alloc_bytes;
+			double start = now();
+			{
+				Parser parser(begin, end);
+				parser.set_single_pass(true);
+				parser.get_document();
+			}
+			Measure m = {now() - start, allocs - a, alloc_bytes - b};
+			keep(best[phase_count], m);
+		}
+		{
+			std::size_t a = allocs, b = alloc_bytes;
+			double start = now();
+			Reader reader(begin, end);
+			Reader::Event e;
+			while (reader.next(e)) {
+			}
+			Measure m = {now() - start, allocs - a, alloc_bytes - b};
+			keep(best[phase_count + 1], m);
+		}
+		{
+			Parser parser(begin, end);
+			parser.set_single_pass(true);
+			parser.get_document();
+			std::size_t a = allocs, b = alloc_bytes;
+			double start = now();
+			std::string out;
+			{
+				Emitter emitter(out);
+				emitter.write(parser.document());
+			}
+			Measure m = {now() - start, allocs - a, alloc_bytes - b};
+			keep(best[phase_count + 2], m);
+		}
+	}
+	for (int i = 0; i < phase_count; ++i) {
+		report(corpus.name, phases[i], text.size(), nodes, best[i]);
+	}
+	report(corpus.name, "single", text.size(), nodes, best[phase_count]);
+	report(corpus.name, "reader", text.size(), nodes, best[phase_count + 1]);
+	report(corpus.name, "emit", text.size(), nodes, best[phase_count + 2]);
+}
+
+static int usage() {
+	std::cerr << "usage: dmonbench [-s size] [-r runs] [-w dir] [corpus...]" << std::endl;
+	return 2;
+}
+
+int main(int argc, char** argv) {
+	std::size_t size = 4 << 20;
+	int runs = 5;
+	std::string dir;
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; ++i) {
+		if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			char *suffix;
+			size = (std::size_t)std::strtoull(argv[++i], &suffix, 10);
+			if (*suffix == 'k' || *suffix == 'K') {
+				size <<= 10;
+			} else if (*suffix == 'm' || *suffix == 'M') {
+				size <<= 20;
+			}
+		} else if (std::strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			runs = std::atoi(argv[++i]);
+		} else if (std::strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+			dir = argv[++i];
+		} else {
+			return usage();
+		}
+	}
+	if (runs < 1) {
+		return usage();
+	}
+	std::vector<const Corpus*> chosen;
+	for (; i < argc; ++i) {
+		const Corpus *found = 0;
+		for (const Corpus& c : corpora) {
+			if (std::strcmp(c.name, argv[i]) == 0) {
+				found = &c;
+			}
+		}
+		if (!found) {
+			std::cerr << "dmonbench: unknown corpus " << argv[i] << std::endl;
+			return usage();
+		}
+		chosen.push_back(found);
+	}
+	if (chosen.empty()) {
+		for (const Corpus& c : corpora) {
+			chosen.push_back(&c);
+		}
+	}
+	std::cout << "corpus\tstage\tbytes\tnodes\tseconds\tmb_per_s\tnodes_per_s\tallocs\talloc_bytes" << std::endl;
+	try {
+		for (const Corpus* c : chosen) {
+			std::string text;
+			Random random(1);
+			c->generate(text, random, size);
+			if (!dir.empty()) {
+				std::string path = dir + "/" + c->name + ".dmon";
+				std::ofstream file(path, std::ios_base::out | std::ios_base::binary);
+				if (!file.write(text.data(), text.size())) {
+					std::cerr << "dmonbench: cannot write " << path << std::endl;
+					return 1;
+				}
+			}
+			bench(*c, text, runs);
+		}
+	} catch (std::exception& e) {
+		std::cerr << "dmonbench: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,94 @@
+// converts dmon documents between the text and binary forms; the form of
+// the input is detected from its header.
+//
+//   dmonconv [-b|-t|-i] [-p] [-s] [-j threads] input output
+//
+//   -b  write binary (the default for text input)
+//   -t  write text (the default for binary input)
+//   -i  write an image to be opened in place with Image
+//   -p  pretty text instead of compact
+//   -s  print the load's statistics to stderr, one name and value a line
+//   -j  load a large text input on this many threads, 0 for one per core
+//
+// built with the top level CMakeLists.txt, or by hand from the library
+// sources, e.g.
+//   c++ -std=c++17 -O2 -I.. ../*.cpp dmonconv.cpp -o dmonconv
+
+#include "../parser.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <iomanip>
+
+static int usage() {
+	std::cerr << "usage: dmonconv [-b|-t|-i] [-p] [-s] [-j threads] input output" << std::endl;
+	return 2;
+}
+
+int main(int argc, char** argv) {
+	char form = 0;
+	Emitter::Style style = Emitter::Compact;
+	unsigned int threads = 1;
+	bool stats = false;
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; ++i) {
+		if (std::strcmp(argv[i], "-b") == 0) {
+			form = 'b';
+		} else if (std::strcmp(argv[i], "-t") == 0) {
+			form = 't';
+		} else if (std::strcmp(argv[i], "-i") == 0) {
+			form = 'i';
+		} else if (std::strcmp(argv[i], "-p") == 0) {
+			style = Emitter::Pretty;
+		} else if (std::strcmp(argv[i], "-s") == 0) {
+			stats = true;
+		} else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			threads = (unsigned int)std::strtoul(argv[++i], 0, 10);
+		} else {
+			return usage();
+		}
+	}
+	if (argc - i != 2) {
+		return usage();
+	}
+	try {
+		Parser parser(std::string(argv[i]), InputBuffer::Mapped);
+		parser.set_single_pass(true);
+		parser.set_zero_copy(true);
+		parser.set_threads(threads);
+		parser.get_document();
+		if (stats) {
+			parser.stats().report([](const std::string& name, double value) {
+				std::cerr << name << " " << std::setprecision(15) << value << std::endl;
+			});
+		}
+		if (!form) {
+			std::ifstream probe(argv[i], std::ios_base::in | std::ios_base::binary);
+			char head[5] = {1, 1, 1, 1, 1};
+			probe.read(head, 5);
+			form = BinaryCursor::is_binary(head, head + probe.gcount()) ? 't' : 'b';
+		}
+		std::string out;
+		if (form == 'b') {
+			Encoder encoder(out);
+			encoder.write(parser.document());
+		} else if (form == 'i') {
+			ImageWriter writer(out);
+			writer.write(parser.document());
+		} else {
+			Emitter emitter(out, style);
+			emitter.write(parser.document());
+		}
+		std::ofstream file(argv[i + 1], std::ios_base::out | std::ios_base::binary);
+		if (!file.write(out.data(), out.size())) {
+			std::cerr << "dmonconv: cannot write " << argv[i + 1] << std::endl;
+			return 1;
+		}
+	} catch (std::exception& e) {
+		std::cerr << "dmonconv: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}